@@ -0,0 +1,320 @@
+/*
+ * FFSMark
+ * Pierre Olivier <pierre.olivier@univ-brest.fr>
+ *
+ * Copyright (c) of University of Occidental Britanny (UBO) <pierre.olivier@univ-brest.fr>, 2015.
+ *
+ *	This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ * NO WARRANTY. THIS SOFTWARE IS FURNISHED ON AN "AS IS" BASIS.
+ * UNIVERSITY OF OCCIDENTAL BRITANNY MAKES NO WARRANTIES OF ANY KIND, EITHER
+ * EXPRESSED OR IMPLIED AS TO THE MATTER INCLUDING, BUT NOT LIMITED
+ * TO: WARRANTY OF FITNESS FOR PURPOSE OR MERCHANTABILITY, EXCLUSIVITY
+ * OF RESULTS OR RESULTS OBTAINED FROM USE OF THIS SOFTWARE. 
+ * See the GNU General Public License for more details.
+ *
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "aging.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <linux/fs.h>
+#include <linux/fiemap.h>
+
+#include "datagen.h"
+#include "fill.h"
+#include "latency.h"
+
+#define MEGABYTE            (1024.0*1024.0)
+#define PROGRESS_PERIOD_NS  1000000000ULL
+#define AGING_FILE_NAME     "a%u"
+#define EXTENTS_PERIOD      1024    /* operations between two samplings */
+#define EXTENTS_SAMPLE      64      /* files per sampling */
+#define AGING_MAX_TURNOVER  64      /* extents only: bound of the bytes
+                                       written, in largest file sets */
+
+typedef struct
+{
+  char *dir;
+  unsigned int *live;         /* ids of the live files */
+  int nlive;
+  unsigned int next_id;
+  uint64_t seed;
+  distrib_stream rnd;         /* choices, apart from the benchmark ones */
+  void *buf;
+  size_distrib *sizes;
+  int low;
+  int high;
+  aging_result *res;
+} aging_state;
+
+static void aging_path(aging_state *a, unsigned int id, char *path,
+  size_t size)
+{
+  snprintf(path, size, "%s/" AGING_FILE_NAME, a->dir, id);
+}
+
+/**
+ * Write 'size' bytes to file 'id', opened with 'flags'
+ */
+static int aging_write(aging_state *a, unsigned int id, int flags, int size)
+{
+  char path[256];
+  int fd, len, done;
+
+  aging_path(a, id, path, sizeof(path));
+  if((fd = open(path, O_WRONLY | flags, S_IRWXU)) == -1)
+    return -1;
+
+  for(done = 0; done < size; done += len)
+  {
+    len = (size - done < FILL_BLOCK) ? size - done : FILL_BLOCK;
+    datagen_fill(a->buf, len, datagen_word(a->seed, a->res->written),
+      0, 0);
+    if(write(fd, a->buf, len) != len)
+    {
+      close(fd);
+      return -1;
+    }
+    a->res->written += len;
+  }
+
+  close(fd);
+  return 0;
+}
+
+static int aging_delete(aging_state *a, int index)
+{
+  char path[256];
+
+  aging_path(a, a->live[index], path, sizeof(path));
+  if(unlink(path) != 0)
+    return -1;
+
+  a->live[index] = a->live[--a->nlive];
+  a->res->deletes++;
+  return 0;
+}
+
+/**
+ * One churn operation: creations up to the file count, then an append or
+ * a delete (replaced by a creation at the next step) with the same
+ * probability
+ */
+static int aging_step(aging_state *a, int files)
+{
+  char path[256];
+  int index, ret, err;
+
+  if(a->nlive == files && distrib_stream_uniform(&a->rnd) < 0.5)
+    return aging_delete(a,
+      (int)(distrib_stream_uniform(&a->rnd) * a->nlive));
+
+  if(a->nlive == files)
+  {
+    index = (int)(distrib_stream_uniform(&a->rnd) * a->nlive);
+    ret = aging_write(a, a->live[index], O_APPEND,
+      fill_size(a->sizes, a->low, a->high, &a->rnd));
+    a->res->appends += (ret == 0);
+    return ret;
+  }
+
+  if((ret = aging_write(a, a->next_id, O_CREAT | O_TRUNC,
+    fill_size(a->sizes, a->low, a->high, &a->rnd))) == 0)
+  {
+    a->live[a->nlive++] = a->next_id++;
+    a->res->creates++;
+  }
+  else
+  {
+    err = errno;              /* no partial file left behind */
+    aging_path(a, a->next_id, path, sizeof(path));
+    unlink(path);
+    errno = err;
+  }
+  return ret;
+}
+
+/**
+ * Mean extents per file over a sample of the live files, -1 when the file
+ * system does not support FIEMAP (UBIFS, JFFS2)
+ */
+static double aging_extents(aging_state *a)
+{
+  struct fiemap map;
+  char path[256];
+  int i, fd, n = (a->nlive < EXTENTS_SAMPLE) ? a->nlive : EXTENTS_SAMPLE;
+  uint64_t extents = 0;
+
+  for(i = 0; i < n; i++)
+  {
+    aging_path(a, a->live[(int)(distrib_stream_uniform(&a->rnd) * a->nlive)],
+      path, sizeof(path));
+    if((fd = open(path, O_RDONLY)) == -1)
+      return -1;
+
+    memset(&map, 0, sizeof(map));
+    map.fm_length = FIEMAP_MAX_OFFSET;
+    map.fm_flags = FIEMAP_FLAG_SYNC;
+    if(ioctl(fd, FS_IOC_FIEMAP, &map) != 0)
+    {
+      close(fd);
+      return -1;
+    }
+    close(fd);
+    extents += map.fm_mapped_extents;
+  }
+
+  return n ? (double)extents / n : 0;
+}
+
+int aging_run(char *dir, uint64_t written, double extents, int files,
+  size_distrib *sizes, int low, int high, aging_result *res)
+{
+  aging_state a;
+  uint64_t start, last, bound, ops = 0;
+  int ret = 0;
+
+  memset(res, 0, sizeof(*res));
+  res->extents = -1;
+
+  memset(&a, 0, sizeof(a));
+  a.dir = dir;
+  a.sizes = sizes;
+  a.low = low;
+  a.high = high;
+  a.res = res;
+  a.seed = ((uint64_t)rand() << 32) ^ (uint64_t)rand();
+  a.rnd.seed = ~a.seed;       /* not the content stream */
+
+  if(mkdir(dir, S_IRWXU) != 0 && errno != EEXIST)
+  {
+    perror("mkdir");
+    return -1;
+  }
+
+  if((a.live = malloc(files * sizeof(unsigned int))) == NULL
+    || posix_memalign(&a.buf, 4096, FILL_BLOCK) != 0)
+  {
+    fprintf(stderr, "Error: cannot allocate the aging state\n");
+    free(a.live);
+    return -1;
+  }
+
+  printf("Aging %s: %d files, until ", dir, files);
+  if(extents > 0)
+    printf("%.2lf extents per file%s", extents, written ? " or " : "\n");
+  if(written)
+    printf("%.1lf MB written\n", written / MEGABYTE);
+
+  /* a fragmentation the file system never reaches must not age forever */
+  bound = written ? written : (uint64_t)AGING_MAX_TURNOVER * files * high;
+
+  start = last = latency_now();
+  while(res->written < bound)
+  {
+    if(aging_step(&a, files) != 0)
+    {
+      /* a full file system keeps aging by making room */
+      if(errno == ENOSPC && a.nlive > 0 && aging_delete(&a, 0) == 0)
+        continue;
+      perror("aging");
+      ret = -1;
+      break;
+    }
+
+    if(extents > 0 && ++ops % EXTENTS_PERIOD == 0)
+    {
+      if((res->extents = aging_extents(&a)) < 0)
+      {
+        fprintf(stderr, "Error: FIEMAP not supported, age by written "
+          "bytes instead\n");
+        ret = -1;
+        break;
+      }
+      if(res->extents >= extents)
+        break;
+    }
+
+    if(latency_now() - last >= PROGRESS_PERIOD_NS)
+    {
+      last = latency_now();
+      printf("\r\t%.1lf MB written, %.2lf MB/s", res->written / MEGABYTE,
+        res->written / MEGABYTE / ((last - start) / 1e9));
+      if(res->extents >= 0)
+        printf(", %.2lf extents per file", res->extents);
+      fflush(stdout);
+    }
+  }
+
+  /* final measure, the period may not have elapsed */
+  if(ret == 0 && extents > 0 && res->extents < extents
+    && (res->extents = aging_extents(&a)) < 0)
+  {
+    fprintf(stderr, "Error: FIEMAP not supported, age by written bytes "
+      "instead\n");
+    ret = -1;
+  }
+
+  sync();
+  res->seconds = (latency_now() - start) / 1e9;
+  res->live = a.nlive;
+
+  printf("\r\t%.1lf MB written, %.2lf MB/s, %.3lf seconds (%llu creates, "
+    "%llu appends, %llu deletes, %d files left)\n", res->written / MEGABYTE,
+    res->seconds > 0 ? res->written / MEGABYTE / res->seconds : 0,
+    res->seconds, (unsigned long long)res->creates,
+    (unsigned long long)res->appends, (unsigned long long)res->deletes,
+    res->live);
+
+  if(ret == 0 && !written && res->extents < extents)
+  {
+    res->missed = 1;
+    fprintf(stderr, "Warning: %.2lf extents per file after %.1lf MB "
+      "written, the target of %.2lf was not reached\n", res->extents,
+      res->written / MEGABYTE, extents);
+  }
+
+  free(a.buf);
+  free(a.live);
+  return ret;
+}
+
+int aging_clean(char *dir)
+{
+  struct dirent *e;
+  char path[512];
+  DIR *d;
+  int ret = 0;
+
+  if((d = opendir(dir)) == NULL)
+    return (errno == ENOENT) ? 0 : -1;
+
+  while((e = readdir(d)) != NULL)
+  {
+    if(!strcmp(e->d_name, ".") || !strcmp(e->d_name, ".."))
+      continue;
+    snprintf(path, sizeof(path), "%s/%s", dir, e->d_name);
+    if(unlink(path) != 0)
+      ret = -1;
+  }
+  closedir(d);
+
+  if(rmdir(dir) != 0)
+    ret = -1;
+  return ret;
+}
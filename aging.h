@@ -0,0 +1,58 @@
+/*
+ * FFSMark
+ * Pierre Olivier <pierre.olivier@univ-brest.fr>
+ *
+ * Copyright (c) of University of Occidental Britanny (UBO) <pierre.olivier@univ-brest.fr>, 2015.
+ *
+ *	This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ * NO WARRANTY. THIS SOFTWARE IS FURNISHED ON AN "AS IS" BASIS.
+ * UNIVERSITY OF OCCIDENTAL BRITANNY MAKES NO WARRANTIES OF ANY KIND, EITHER
+ * EXPRESSED OR IMPLIED AS TO THE MATTER INCLUDING, BUT NOT LIMITED
+ * TO: WARRANTY OF FITNESS FOR PURPOSE OR MERCHANTABILITY, EXCLUSIVITY
+ * OF RESULTS OR RESULTS OBTAINED FROM USE OF THIS SOFTWARE. 
+ * See the GNU General Public License for more details.
+ *
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef AGING_H
+#define AGING_H
+
+#include <stdint.h>
+
+#include "distrib.h"
+
+/**
+ * Aging phase: create/append/delete churn on a set of about 'files' files
+ * of directory 'dir', sizes drawn as by fill_size(),
+ * until 'written' bytes have been written (if not 0) or, when 'extents'
+ * > 0, until the live files average 'extents' extents (FIEMAP, sampled),
+ * whichever comes first. With an extents target only, the churn gives up
+ * after writing 64 times 'files' files of size 'high', the result being
+ * marked as missed. The surviving files are kept as the
+ * aged state of the file system until aging_clean() removes 'dir'.
+ */
+typedef struct
+{
+  uint64_t creates;
+  uint64_t appends;
+  uint64_t deletes;
+  uint64_t written;           /* bytes */
+  double seconds;
+  double extents;             /* extents per file, < 0 if not measured */
+  int live;                   /* files left */
+  int missed;                 /* extents target not reached */
+} aging_result;
+
+int aging_run(char *dir, uint64_t written, double extents, int files,
+  size_distrib *sizes, int low, int high, aging_result *res);
+int aging_clean(char *dir);
+
+#endif /* AGING_H */
@@ -0,0 +1,272 @@
+/*
+ * FFSMark
+ * Pierre Olivier <pierre.olivier@univ-brest.fr>
+ *
+ * Copyright (c) of University of Occidental Britanny (UBO) <pierre.olivier@univ-brest.fr>, 2015.
+ *
+ *	This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ * NO WARRANTY. THIS SOFTWARE IS FURNISHED ON AN "AS IS" BASIS.
+ * UNIVERSITY OF OCCIDENTAL BRITANNY MAKES NO WARRANTIES OF ANY KIND, EITHER
+ * EXPRESSED OR IMPLIED AS TO THE MATTER INCLUDING, BUT NOT LIMITED
+ * TO: WARRANTY OF FITNESS FOR PURPOSE OR MERCHANTABILITY, EXCLUSIVITY
+ * OF RESULTS OR RESULTS OBTAINED FROM USE OF THIS SOFTWARE. 
+ * See the GNU General Public License for more details.
+ *
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "datagen.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define GAMMA       0x9e3779b97f4a7c15ULL
+#define EVEN_HALVES 0x0000ffff0000ffffULL
+#define LOW_7_BITS  0x0000007f0000007fULL
+#define SPACES      0x2020202020202020ULL
+
+static inline uint64_t word(uint64_t seed, uint64_t n)
+{
+  uint64_t z = seed + (n + 1) * GAMMA;
+
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+  return z ^ (z >> 31);
+}
+
+uint64_t datagen_word(uint64_t seed, uint64_t n)
+{
+  return word(seed, n);
+}
+
+/**
+ * Four values in [0, 94] from the 16-bit halves of w: every 32-bit lane
+ * holds one half, v * 95 < 2^23 so lanes never carry into each other
+ */
+static inline uint64_t printable_half(uint64_t w)
+{
+  uint64_t even = (((w & EVEN_HALVES) * 95) >> 16) & LOW_7_BITS;
+  uint64_t odd = ((((w >> 16) & EVEN_HALVES) * 95) >> 16) & LOW_7_BITS;
+
+  return (even & 0x7f) | ((odd & 0x7f) << 8) | ((even >> 32) << 16)
+    | ((odd >> 32) << 24);
+}
+
+/**
+ * Word n of the stream, as it is written to the buffer
+ */
+static inline uint64_t stream_word(uint64_t seed, uint64_t n, int printable)
+{
+  if(!printable)
+    return word(seed, n);
+
+  return (printable_half(word(seed, 2 * n))
+    | (printable_half(word(seed, 2 * n + 1)) << 32)) + SPACES;
+}
+
+/**
+ * Uniform double in [0, 1) from the top 53 bits of w
+ */
+static double unit(uint64_t w)
+{
+  return (w >> 11) * (1.0 / 9007199254740992.0);
+}
+
+/**
+ * Fill buf with words first, first + 1, ... of stream seed
+ */
+void datagen_fill(void *buf, size_t size, uint64_t seed, uint64_t first,
+  int printable)
+{
+  unsigned char *p = buf;
+  uint64_t w;
+  size_t i;
+
+  for(i = 0; i + sizeof(w) <= size; i += sizeof(w))
+  {
+    w = stream_word(seed, first++, printable);
+    memcpy(p + i, &w, sizeof(w));
+  }
+
+  if(i < size)
+  {
+    w = stream_word(seed, first, printable);
+    memcpy(p + i, &w, size - i);
+  }
+}
+
+/**
+ * Chunk 'key' of a compressible stream, 'size' <= DATAGEN_CHUNK
+ */
+void datagen_chunk(void *buf, size_t size, uint64_t seed, uint64_t key,
+  double random_fraction)
+{
+  unsigned char *p = buf;
+  uint64_t chunk_seed = datagen_word(seed, key), u;
+  size_t i, len;
+  int j;
+
+  for(i = 0, j = 0; i < size; i += DATAGEN_SEGMENT, j++)
+  {
+    len = (size - i < DATAGEN_SEGMENT) ? size - i : DATAGEN_SEGMENT;
+    u = datagen_word(~chunk_seed, j);
+
+    if(unit(u) < random_fraction)
+      datagen_fill(p + i, len, chunk_seed, j * (DATAGEN_SEGMENT / 8), 0);
+    else if(j == 0)
+      memset(p, 0, len);
+    else
+      memcpy(p + i, p + (u % j) * DATAGEN_SEGMENT, len);
+  }
+}
+
+/**
+ * Random fraction giving chunks an estimated compression ratio of 'ratio'
+ * (bisection over a sample of chunks)
+ */
+double datagen_calibrate(double ratio, uint64_t seed)
+{
+  size_t size = 64 * DATAGEN_CHUNK, i;
+  unsigned char *sample = malloc(size);
+  double low = 0.0, high = 1.0, mid = 1.0;
+  int step;
+
+  if(sample == NULL || ratio <= 1.0)
+  {
+    free(sample);
+    return 1.0;
+  }
+
+  for(step = 0; step < 16; step++)
+  {
+    mid = (low + high) / 2;
+    for(i = 0; i < size; i += DATAGEN_CHUNK)
+      datagen_chunk(sample + i, DATAGEN_CHUNK, seed, i / DATAGEN_CHUNK, mid);
+
+    if((double)size / datagen_lz_estimate(sample, size) > ratio)
+      low = mid;              /* compresses too well: more random data */
+    else
+      high = mid;
+  }
+
+  free(sample);
+  return mid;
+}
+
+/**
+ * Bytes [from, to) of stream seed
+ */
+static void fill_range(unsigned char *p, uint64_t seed, size_t from,
+  size_t to, int printable)
+{
+  size_t head = from % sizeof(uint64_t);
+  uint64_t w;
+
+  if(head)
+  {
+    w = stream_word(seed, from / sizeof(w), printable);
+    head = sizeof(w) - head;
+    if(head > to - from)
+      head = to - from;
+    memcpy(p, (unsigned char *)&w + from % sizeof(w), head);
+    p += head;
+    from += head;
+  }
+
+  if(from < to)
+    datagen_fill(p, to - from, seed, from / sizeof(w), printable);
+}
+
+void datagen_content_fill(const datagen_content *c, void *buf, size_t size,
+  uint64_t file, uint64_t offset)
+{
+  unsigned char *p = buf, chunk[DATAGEN_CHUNK];
+  uint64_t file_seed = datagen_word(c->seed, file), block, block_seed;
+  size_t from, to;
+
+  while(size > 0)
+  {
+    block = offset / DATAGEN_CHUNK;
+    from = offset % DATAGEN_CHUNK;
+    to = (DATAGEN_CHUNK - from < size) ? DATAGEN_CHUNK : from + size;
+
+    block_seed = datagen_word(file_seed, block);
+    if(c->dedupe > 0 && unit(datagen_word(~file_seed, block)) < c->dedupe)
+      block_seed = datagen_word(~c->seed, block_seed % DATAGEN_DEDUPE_POOL);
+
+    if(c->random_fraction < 0)
+      fill_range(p, block_seed, from, to, c->printable);
+    else if(from == 0 && to == DATAGEN_CHUNK)
+      datagen_chunk(p, DATAGEN_CHUNK, block_seed, 0, c->random_fraction);
+    else
+    {
+      datagen_chunk(chunk, to, block_seed, 0, c->random_fraction);
+      memcpy(p, chunk + from, to - from);
+    }
+
+    p += to - from;
+    offset += to - from;
+    size -= to - from;
+  }
+}
+
+#define LZ_HASH_BITS  12
+#define LZ_MIN_MATCH  4
+
+static size_t lz_chunk(const unsigned char *p, size_t n)
+{
+  uint16_t table[1 << LZ_HASH_BITS];  /* position + 1, 0 when empty */
+  size_t i = 0, literals = 0, cost = 0, len, cand;
+  uint32_t v;
+  unsigned int h;
+
+  memset(table, 0, sizeof(table));
+
+  while(i + LZ_MIN_MATCH <= n)
+  {
+    memcpy(&v, p + i, sizeof(v));
+    h = (v * 2654435761U) >> (32 - LZ_HASH_BITS);
+    cand = table[h];
+    table[h] = i + 1;
+
+    if(cand && !memcmp(p + cand - 1, p + i, LZ_MIN_MATCH))
+    {
+      for(len = LZ_MIN_MATCH; i + len < n && p[cand - 1 + len] == p[i + len];
+        len++)
+        ;
+      /* token, literals, 2-byte offset, length extension bytes */
+      cost += 1 + literals + 2 + (len >= 19 ? (len - 19) / 255 + 1 : 0)
+        + (literals >= 15 ? (literals - 15) / 255 + 1 : 0);
+      literals = 0;
+      i += len;
+    }
+    else
+    {
+      literals++;
+      i++;
+    }
+  }
+
+  literals += n - i;
+  cost += 1 + literals + (literals >= 15 ? (literals - 15) / 255 + 1 : 0);
+
+  return (cost < n) ? cost : n;
+}
+
+size_t datagen_lz_estimate(const void *buf, size_t size)
+{
+  const unsigned char *p = buf;
+  size_t i, total = 0;
+
+  for(i = 0; i < size; i += DATAGEN_CHUNK)
+    total += lz_chunk(p + i, (size - i < DATAGEN_CHUNK) ? size - i :
+      DATAGEN_CHUNK);
+
+  return total;
+}
@@ -0,0 +1,81 @@
+/*
+ * FFSMark
+ * Pierre Olivier <pierre.olivier@univ-brest.fr>
+ *
+ * Copyright (c) of University of Occidental Britanny (UBO) <pierre.olivier@univ-brest.fr>, 2015.
+ *
+ *	This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ * NO WARRANTY. THIS SOFTWARE IS FURNISHED ON AN "AS IS" BASIS.
+ * UNIVERSITY OF OCCIDENTAL BRITANNY MAKES NO WARRANTIES OF ANY KIND, EITHER
+ * EXPRESSED OR IMPLIED AS TO THE MATTER INCLUDING, BUT NOT LIMITED
+ * TO: WARRANTY OF FITNESS FOR PURPOSE OR MERCHANTABILITY, EXCLUSIVITY
+ * OF RESULTS OR RESULTS OBTAINED FROM USE OF THIS SOFTWARE. 
+ * See the GNU General Public License for more details.
+ *
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef DATAGEN_H
+#define DATAGEN_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Bulk pseudo-random data: word n of a stream is the splitmix64 finalizer
+ * of seed + n * golden gamma, so any part of a stream can be generated
+ * on its own. Printable streams take two words per eight bytes and map
+ * each 16-bit value v to 32 + (v * 95) / 65536, four values per
+ * multiplication pair (SWAR).
+ */
+uint64_t datagen_word(uint64_t seed, uint64_t n);
+void datagen_fill(void *buf, size_t size, uint64_t seed, uint64_t first,
+  int printable);
+
+/**
+ * Compressible data: every DATAGEN_CHUNK bytes (the compression unit of
+ * UBIFS and JFFS2) are made of DATAGEN_SEGMENT byte segments, random with
+ * probability 'random_fraction' and otherwise copies of an earlier segment
+ * of the chunk. Chunks only depend on (seed, key).
+ */
+#define DATAGEN_CHUNK     4096
+#define DATAGEN_SEGMENT   64
+
+void datagen_chunk(void *buf, size_t size, uint64_t seed, uint64_t key,
+  double random_fraction);
+double datagen_calibrate(double ratio, uint64_t seed);
+
+/**
+ * Per-file content: byte o of file 'file' only depends on (seed, file, o),
+ * generated DATAGEN_CHUNK block by block. A 'dedupe' fraction of the
+ * blocks are copies of one of DATAGEN_DEDUPE_POOL blocks shared by all
+ * files. Blocks are compressible chunks when random_fraction >= 0, plain
+ * (printable or binary) streams otherwise.
+ */
+#define DATAGEN_DEDUPE_POOL 64
+
+typedef struct
+{
+  uint64_t seed;
+  double dedupe;              /* fraction of duplicate blocks */
+  double random_fraction;     /* datagen_chunk() parameter, < 0 for none */
+  int printable;
+} datagen_content;
+
+void datagen_content_fill(const datagen_content *c, void *buf, size_t size,
+  uint64_t file, uint64_t offset);
+
+/**
+ * Size of buf once compressed chunk by chunk by a greedy LZ77 coder
+ * (LZ4-like costs, incompressible chunks stored as is)
+ */
+size_t datagen_lz_estimate(const void *buf, size_t size);
+
+#endif /* DATAGEN_H */
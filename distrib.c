@@ -0,0 +1,477 @@
+/*
+ * FFSMark
+ * Pierre Olivier <pierre.olivier@univ-brest.fr>
+ *
+ * Copyright (c) of University of Occidental Britanny (UBO) <pierre.olivier@univ-brest.fr>, 2015.
+ *
+ *	This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ * NO WARRANTY. THIS SOFTWARE IS FURNISHED ON AN "AS IS" BASIS.
+ * UNIVERSITY OF OCCIDENTAL BRITANNY MAKES NO WARRANTIES OF ANY KIND, EITHER
+ * EXPRESSED OR IMPLIED AS TO THE MATTER INCLUDING, BUT NOT LIMITED
+ * TO: WARRANTY OF FITNESS FOR PURPOSE OR MERCHANTABILITY, EXCLUSIVITY
+ * OF RESULTS OR RESULTS OBTAINED FROM USE OF THIS SOFTWARE. 
+ * See the GNU General Public License for more details.
+ *
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "distrib.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "datagen.h"
+
+extern unsigned long genrand();
+
+static void zipf_update(zipf_state *z);
+static double size_cdf(size_distrib *d, double x);
+static int size_load_histogram(size_distrib *d);
+static int alias_build(size_distrib *d, double *weights);
+
+/* uniform double in [0, 1[ */
+double distrib_uniform()
+{
+  return (double)genrand() / 4294967296.0;
+}
+
+/* uniform double in [0, 1[ from a private stream */
+double distrib_stream_uniform(distrib_stream *s)
+{
+  return (datagen_word(s->seed, s->n++) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+/* benchmark generator when s is NULL */
+static double stream_uniform(distrib_stream *s)
+{
+  return s ? distrib_stream_uniform(s) : distrib_uniform();
+}
+
+void zipf_init(zipf_state *z, double theta)
+{
+  memset(z, 0, sizeof(zipf_state));
+  z->theta = theta;
+  z->alpha = 1.0 / (1.0 - theta);
+  z->zeta2 = 1.0 + pow(0.5, theta);
+}
+
+/**
+ * Rank in [0, n), rank 0 being the most popular
+ */
+int zipf_next(zipf_state *z, int n)
+{
+  double u, uz;
+  int rank;
+
+  if(n <= 1)
+    return 0;
+
+  /* follow the population size, one term of zeta(n) at a time */
+  if(z->n != n)
+  {
+    while(z->n < n)
+      z->zetan += 1.0 / pow(z->n++ + 1, z->theta);
+    while(z->n > n)
+      z->zetan -= 1.0 / pow(z->n--, z->theta);
+    zipf_update(z);
+  }
+
+  u = distrib_uniform();
+  uz = u * z->zetan;
+
+  if(uz < 1.0)
+    return 0;
+  if(uz < z->zeta2)
+    return 1;
+
+  rank = (int)(n * pow(z->eta * u - z->eta + 1.0, z->alpha));
+  return (rank < n) ? rank : n - 1;
+}
+
+/**
+ * The first fraction of [0, n) is hot and picked with the given
+ * probability, the rest is cold
+ */
+int hotset_next(int n, double fraction, double probability)
+{
+  int hot = (int)ceil(fraction * n);
+
+  if(hot <= 0 || hot >= n)
+    return (int)(distrib_uniform() * n);
+
+  if(distrib_uniform() < probability)
+    return (int)(distrib_uniform() * hot);
+
+  return hot + (int)(distrib_uniform() * (n - hot));
+}
+
+/**
+ * Parse "uniform", "zipf <theta>" or "hotset <fraction> <probability>"
+ */
+int popularity_parse(char *param, popularity_config *p)
+{
+  double a, b;
+
+  if(param && !strcmp(param, "uniform"))
+    p->type = POPULARITY_UNIFORM;
+  else if(param && sscanf(param, "zipf %lf", &a) == 1)
+  {
+    if(a <= 0.0 || a >= 1.0)
+    {
+      fprintf(stderr, "Error: zipf theta must be in ]0, 1[\n");
+      return -1;
+    }
+    p->type = POPULARITY_ZIPF;
+    p->theta = a;
+  }
+  else if(param && sscanf(param, "hotset %lf %lf", &a, &b) == 2)
+  {
+    if(a <= 0.0 || a >= 1.0 || b < 0.0 || b > 1.0)
+    {
+      fprintf(stderr, "Error: hotset fraction must be in ]0, 1[ and "
+        "probability in [0, 1]\n");
+      return -1;
+    }
+    p->type = POPULARITY_HOTSET;
+    p->hot_fraction = a;
+    p->hot_probability = b;
+  }
+  else
+  {
+    fprintf(stderr, "Error: please indicate uniform, zipf <theta> or "
+      "hotset <fraction> <probability>\n");
+    return -1;
+  }
+
+  return 0;
+}
+
+void popularity_show(FILE *fp, popularity_config *p)
+{
+  if(p->type == POPULARITY_ZIPF)
+    fprintf(fp, "File popularity is zipfian (theta=%.3lf)\n", p->theta);
+  else if(p->type == POPULARITY_HOTSET)
+    fprintf(fp, "File popularity is hot/cold: %.1lf%% of the files get "
+      "%.1lf%% of the accesses\n", p->hot_fraction * 100.0,
+      p->hot_probability * 100.0);
+  else
+    fprintf(fp, "File popularity is uniform\n");
+}
+
+static void zipf_update(zipf_state *z)
+{
+  z->eta = (1.0 - pow(2.0 / z->n, 1.0 - z->theta)) / 
+    (1.0 - z->zeta2 / z->zetan);
+}
+
+/**
+ * Parse "uniform", "lognormal <mu> <sigma>", "pareto <alpha> <xm>",
+ * "buckets <size>:<weight> ..." or "empirical <file>" where the file
+ * holds one "<size> <weight>" pair per line
+ */
+int size_distrib_parse(char *param, size_distrib *d)
+{
+  size_distrib n;
+  char *tok, *save, buf[256];
+  double a, b;
+
+  memset(&n, 0, sizeof(n));
+
+  if(param && !strcmp(param, "uniform"))
+    n.type = SIZE_UNIFORM;
+  else if(param && sscanf(param, "lognormal %lf %lf", &a, &b) == 2 && b > 0)
+  {
+    n.type = SIZE_LOGNORMAL;
+    n.p1 = a;
+    n.p2 = b;
+  }
+  else if(param && sscanf(param, "pareto %lf %lf", &a, &b) == 2 && a > 0 &&
+    b > 0)
+  {
+    n.type = SIZE_PARETO;
+    n.p1 = a;
+    n.p2 = b;
+  }
+  else if(param && !strncmp(param, "buckets ", 8))
+  {
+    n.type = SIZE_BUCKETS;
+    strncpy(buf, param + 8, sizeof(buf) - 1);
+    buf[sizeof(buf) - 1] = '\0';
+    for(tok = strtok_r(buf, " ", &save); tok; tok = strtok_r(NULL, " ", &save))
+    {
+      if(n.nbuckets == SIZE_MAX_BUCKETS || sscanf(tok, "%d:%lf",
+        &n.bucket_size[n.nbuckets], &n.bucket_weight[n.nbuckets]) != 2 ||
+        n.bucket_size[n.nbuckets] <= 0 || n.bucket_weight[n.nbuckets] < 0)
+      {
+        fprintf(stderr, "Error: invalid bucket '%s'\n", tok);
+        return -1;
+      }
+      n.nbuckets++;
+    }
+    if(!n.nbuckets)
+    {
+      fprintf(stderr, "Error: no bucket specified\n");
+      return -1;
+    }
+  }
+  else if(param && sscanf(param, "empirical %127s", n.path) == 1)
+  {
+    n.type = SIZE_EMPIRICAL;
+    if(size_load_histogram(&n) != 0)
+      return -1;
+  }
+  else
+  {
+    fprintf(stderr, "Error: please indicate uniform, lognormal <mu> <sigma>,"
+      " pareto <alpha> <xm>, buckets <size>:<weight> ... or empirical "
+      "<file>\n");
+    return -1;
+  }
+
+  size_distrib_free(d);
+  *d = n;
+  return 0;
+}
+
+/**
+ * Build the alias table for sizes within [low, high]
+ */
+int size_distrib_build(size_distrib *d, int low, int high)
+{
+  double *w;
+  int i, span, nbins;
+
+  size_distrib_free(d);
+  if(d->type == SIZE_UNIFORM)
+    return 0;
+
+  nbins = (d->type == SIZE_BUCKETS || d->type == SIZE_EMPIRICAL) ? 
+    d->nbuckets : SIZE_BINS;
+  span = high - low + 1;
+  if(d->type != SIZE_BUCKETS && d->type != SIZE_EMPIRICAL && span < nbins)
+    nbins = span;
+
+  d->low = (int *)malloc(nbins * sizeof(int));
+  d->width = (int *)malloc(nbins * sizeof(int));
+  d->prob = (double *)malloc(nbins * sizeof(double));
+  d->alias = (int *)malloc(nbins * sizeof(int));
+  w = (double *)malloc(nbins * sizeof(double));
+  if(!d->low || !d->width || !d->prob || !d->alias || !w)
+  {
+    fprintf(stderr, "Error: cannot allocate size distribution\n");
+    free(w);
+    size_distrib_free(d);
+    return -1;
+  }
+  d->n = nbins;
+
+  for(i = 0; i < nbins; i++)
+  {
+    if(d->type == SIZE_BUCKETS || d->type == SIZE_EMPIRICAL)
+    {
+      /* exact sizes, clamped to the allowed range */
+      d->low[i] = d->bucket_size[i];
+      if(d->low[i] < low)
+        d->low[i] = low;
+      if(d->low[i] > high)
+        d->low[i] = high;
+      d->width[i] = 1;
+      w[i] = d->bucket_weight[i];
+    }
+    else
+    {
+      /* the distribution truncated to [low, high] */
+      d->low[i] = low + (int)(((long)span * i) / nbins);
+      d->width[i] = low + (int)(((long)span * (i + 1)) / nbins) - d->low[i];
+      w[i] = size_cdf(d, d->low[i] + d->width[i] - 0.5) - 
+        size_cdf(d, d->low[i] - 0.5);
+    }
+  }
+
+  i = alias_build(d, w);
+  free(w);
+  if(i != 0)
+  {
+    fprintf(stderr, "Error: size distribution has no weight within "
+      "[%d, %d]\n", low, high);
+    size_distrib_free(d);
+  }
+
+  return i;
+}
+
+void size_distrib_free(size_distrib *d)
+{
+  free(d->low);
+  free(d->width);
+  free(d->prob);
+  free(d->alias);
+  d->low = d->width = d->alias = NULL;
+  d->prob = NULL;
+  d->n = 0;
+}
+
+int size_distrib_next(size_distrib *d)
+{
+  return size_distrib_draw(d, NULL);
+}
+
+/**
+ * Size drawn from stream s, or from the benchmark generator if s is NULL
+ */
+int size_distrib_draw(size_distrib *d, distrib_stream *s)
+{
+  double u = stream_uniform(s) * d->n;
+  int bin = (int)u;
+
+  if(u - bin >= d->prob[bin])
+    bin = d->alias[bin];
+
+  if(d->width[bin] == 1)
+    return d->low[bin];
+
+  return d->low[bin] + (int)(stream_uniform(s) * d->width[bin]);
+}
+
+void size_distrib_show(FILE *fp, char *what, size_distrib *d)
+{
+  switch(d->type)
+  {
+    case SIZE_LOGNORMAL:
+      fprintf(fp, "%s sizes are lognormal (mu=%.3lf, sigma=%.3lf)\n", what,
+        d->p1, d->p2);
+      break;
+    case SIZE_PARETO:
+      fprintf(fp, "%s sizes are pareto (alpha=%.3lf, xm=%.0lf)\n", what,
+        d->p1, d->p2);
+      break;
+    case SIZE_BUCKETS:
+      fprintf(fp, "%s sizes are drawn from %d buckets\n", what, 
+        d->nbuckets);
+      break;
+    case SIZE_EMPIRICAL:
+      fprintf(fp, "%s sizes are drawn from histogram %s (%d sizes)\n", 
+        what, d->path, d->nbuckets);
+      break;
+    default:
+      fprintf(fp, "%s sizes are uniform\n", what);
+  }
+}
+
+static double size_cdf(size_distrib *d, double x)
+{
+  if(x <= 0)
+    return 0.0;
+
+  if(d->type == SIZE_LOGNORMAL)
+    return 0.5 * erfc(-(log(x) - d->p1) / (d->p2 * sqrt(2.0)));
+
+  /* pareto */
+  if(x < d->p2)
+    return 0.0;
+  return 1.0 - pow(d->p2 / x, d->p1);
+}
+
+static int size_load_histogram(size_distrib *d)
+{
+  FILE *f;
+  char line[128];
+
+  f = fopen(d->path, "r");
+  if(f == NULL)
+  {
+    fprintf(stderr, "Error: cannot open histogram '%s'\n", d->path);
+    return -1;
+  }
+
+  d->nbuckets = 0;
+  while(fgets(line, sizeof(line), f))
+  {
+    if(line[0] == '#' || line[0] == '\n')
+      continue;
+
+    if(d->nbuckets == SIZE_MAX_BUCKETS || sscanf(line, "%d %lf", 
+      &d->bucket_size[d->nbuckets], &d->bucket_weight[d->nbuckets]) != 2 ||
+      d->bucket_size[d->nbuckets] <= 0 || d->bucket_weight[d->nbuckets] < 0)
+    {
+      fprintf(stderr, "Error: invalid histogram line '%s'\n", line);
+      fclose(f);
+      return -1;
+    }
+    d->nbuckets++;
+  }
+
+  fclose(f);
+  if(!d->nbuckets)
+  {
+    fprintf(stderr, "Error: empty histogram '%s'\n", d->path);
+    return -1;
+  }
+
+  return 0;
+}
+
+/**
+ * Vose's alias method: prob[i] is the probability to keep bin i once it
+ * has been drawn uniformly, alias[i] the bin to use otherwise
+ */
+static int alias_build(size_distrib *d, double *weights)
+{
+  int *small, *large;
+  int ns = 0, nl = 0, i, s, l;
+  double total = 0.0;
+
+  for(i = 0; i < d->n; i++)
+    total += weights[i];
+  if(total <= 0.0)
+    return -1;
+
+  small = (int *)malloc(d->n * sizeof(int));
+  large = (int *)malloc(d->n * sizeof(int));
+  if(!small || !large)
+  {
+    free(small);
+    free(large);
+    return -1;
+  }
+
+  for(i = 0; i < d->n; i++)
+  {
+    d->prob[i] = weights[i] * d->n / total;
+    d->alias[i] = i;
+    if(d->prob[i] < 1.0)
+      small[ns++] = i;
+    else
+      large[nl++] = i;
+  }
+
+  while(ns && nl)
+  {
+    s = small[--ns];
+    l = large[--nl];
+    d->alias[s] = l;
+    d->prob[l] -= 1.0 - d->prob[s];
+    if(d->prob[l] < 1.0)
+      small[ns++] = l;
+    else
+      large[nl++] = l;
+  }
+
+  /* leftovers are 1 up to rounding errors */
+  while(nl)
+    d->prob[large[--nl]] = 1.0;
+  while(ns)
+    d->prob[small[--ns]] = 1.0;
+
+  free(small);
+  free(large);
+  return 0;
+}
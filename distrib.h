@@ -0,0 +1,122 @@
+/*
+ * FFSMark
+ * Pierre Olivier <pierre.olivier@univ-brest.fr>
+ *
+ * Copyright (c) of University of Occidental Britanny (UBO) <pierre.olivier@univ-brest.fr>, 2015.
+ *
+ *	This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ * NO WARRANTY. THIS SOFTWARE IS FURNISHED ON AN "AS IS" BASIS.
+ * UNIVERSITY OF OCCIDENTAL BRITANNY MAKES NO WARRANTIES OF ANY KIND, EITHER
+ * EXPRESSED OR IMPLIED AS TO THE MATTER INCLUDING, BUT NOT LIMITED
+ * TO: WARRANTY OF FITNESS FOR PURPOSE OR MERCHANTABILITY, EXCLUSIVITY
+ * OF RESULTS OR RESULTS OBTAINED FROM USE OF THIS SOFTWARE. 
+ * See the GNU General Public License for more details.
+ *
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef DISTRIB_H
+#define DISTRIB_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+/**
+ * Random distributions used to shape the workload. Random numbers come
+ * from the benchmark generator (genrand()) of the calling thread, so runs
+ * stay reproducible for a given seed.
+ */
+
+/**
+ * Private stream of uniform numbers (datagen words) for the phases that
+ * run before the transactions and must not shift the benchmark generator
+ * (aging, fragmented fill)
+ */
+typedef struct
+{
+  uint64_t seed;
+  uint64_t n;                 /* next word */
+} distrib_stream;
+
+/* file popularity: which live file a read/append/delete targets */
+#define POPULARITY_UNIFORM  0
+#define POPULARITY_ZIPF     1
+#define POPULARITY_HOTSET   2
+
+typedef struct
+{
+  int type;
+  double theta;               /* zipf skew, in ]0, 1[ */
+  double hot_fraction;        /* hotset: fraction of files being hot */
+  double hot_probability;     /* hotset: probability to pick a hot file */
+} popularity_config;
+
+/**
+ * Zipf generator over ranks [0, n) (Gray et al., "Quickly generating
+ * billion-record synthetic databases"): O(1) per sample, zeta(n) being
+ * updated incrementally when n changes.
+ */
+typedef struct
+{
+  int n;
+  double theta;
+  double zetan, zeta2, alpha, eta;
+} zipf_state;
+
+/* file sizes: initial size of created files and size of appends */
+#define SIZE_UNIFORM    0
+#define SIZE_LOGNORMAL  1
+#define SIZE_PARETO     2
+#define SIZE_BUCKETS    3
+#define SIZE_EMPIRICAL  4
+
+#define SIZE_BINS           1024
+#define SIZE_MAX_BUCKETS    256
+
+/**
+ * Continuous distributions are cut into SIZE_BINS bins over the allowed
+ * size range, buckets and empirical histograms keep their exact sizes.
+ * Bins are drawn in O(1) from a Walker/Vose alias table, then a size is
+ * drawn uniformly within the bin.
+ */
+typedef struct
+{
+  int type;
+  double p1, p2;              /* lognormal mu/sigma, pareto alpha/xm */
+  int nbuckets;               /* buckets: sizes and weights */
+  int bucket_size[SIZE_MAX_BUCKETS];
+  double bucket_weight[SIZE_MAX_BUCKETS];
+  char path[128];             /* empirical: histogram file */
+
+  /* alias table, built for a size range by size_distrib_build() */
+  int n;
+  int *low;                   /* lowest size of each bin */
+  int *width;                 /* number of sizes in each bin */
+  double *prob;
+  int *alias;
+} size_distrib;
+
+double distrib_uniform();
+double distrib_stream_uniform(distrib_stream *s);
+
+void zipf_init(zipf_state *z, double theta);
+int zipf_next(zipf_state *z, int n);
+int hotset_next(int n, double fraction, double probability);
+int popularity_parse(char *param, popularity_config *p);
+void popularity_show(FILE *fp, popularity_config *p);
+
+int size_distrib_parse(char *param, size_distrib *d);
+int size_distrib_build(size_distrib *d, int low, int high);
+void size_distrib_free(size_distrib *d);
+int size_distrib_next(size_distrib *d);
+int size_distrib_draw(size_distrib *d, distrib_stream *s);
+void size_distrib_show(FILE *fp, char *what, size_distrib *d);
+
+#endif /* DISTRIB_H */
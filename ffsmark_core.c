@@ -35,16 +35,34 @@
 #include <stdint.h>
 #include <stdlib.h>
 #include <fcntl.h>
+#include <math.h>
 #include <sys/types.h>
+#include <sys/ioctl.h>
+#include <sys/sysmacros.h>
+#include <linux/fs.h>
 
 #include "flashmon_ctrl.h"
 #include "syscaches.h"
+#include "uring_engine.h"
+#include "interval.h"
+#include "optrace.h"
+#include "distrib.h"
+#include "fill.h"
+#include "aging.h"
+#include "results.h"
+#include "report.h"
 
-#define RANDOM_DATA_SRC     "/dev/urandom"
 #define VALID_FILE_NAME     "__ffsmark_valid__"
 #define INVALID_FILE_NAME   "__ffsmark_invalid__"
+#define ALIGN_FILE_NAME     "__ffsmark_align__"
+#define FILL_DIR_NAME       "__ffsmark_fill__"
+#define AGING_DIR_NAME      "__ffsmark_aging__"
+#define MEGABYTE            (1024.0*1024.0)
+#define DEFAULT_DIRECT_ALIGN  512
 
 int open_flags = 0;
+int io_engine = IO_ENGINE_SYNC;
+int io_queue_depth = 32;
 
 typedef struct
 {
@@ -56,17 +74,39 @@ typedef struct
   double fill_valid_transaction;
   double fill_invalid_transaction;
   char location[128];
+  int interval_ms;
+  char interval_path[128];
+  char record_path[128];
+  int fill_threads;
+  int fill_fallocate;
+  int fill_fragmented;
+  int fill_low;
+  int fill_high;
+  size_distrib fill_sizes;
+  int fill_valid_run;
+  int fill_invalid_run;
+  uint64_t aging_written;
+  double aging_extents;
+  int aging_files;
 } ffsmark_config;
 
 int post_bench_read_num;
 int post_bench_write_num;
 flashmon_ctrl_erase_info post_bench_flash_ei;
+int direct_fallbacks;
+int aging_done;
+char aging_dir[256];          /* removed once the run is over */
+aging_result aging_res;
+int aging_write_num;
+flashmon_ctrl_erase_info aging_flash_ei;
 
-static ffsmark_config cfg = {0, 0, 0, 0, 0, 0, 0, "./"};
+static ffsmark_config cfg = {0, 0, 0, 0, 0, 0, 0, "./", 0, "", "", 1, 0, 0,
+  4096, 65536, {SIZE_UNIFORM}, 0, 0, 0, 0, 1000};
 
 static int fill_valid_invalid(char *path, double valid_ratio, 
   double invalid_ratio);
 static int ffsmark_core_create_file(char *path, uint64_t size);
+static int age();
 
 
 int cli_set_flashmon(char *param)
@@ -113,6 +153,50 @@ int ffsmark_core_cli_show(FILE *fp)
     
   fprintf(fp, "Transaction fill rate (valid/invalid): %lf/%lf.\n",
     cfg.fill_valid_transaction, cfg.fill_invalid_transaction);
+
+  fprintf(fp, "Fill: %d writer thread%s, fallocate %s.\n", cfg.fill_threads,
+    (cfg.fill_threads > 1) ? "s" : "", cfg.fill_fallocate ? "on" : "off");
+  if(cfg.fill_fragmented)
+  {
+    fprintf(fp, "Fragmented fill: files of %d to %d bytes, ", cfg.fill_low,
+      cfg.fill_high);
+    if(cfg.fill_valid_run + cfg.fill_invalid_run)
+      fprintf(fp, "runs of %d valid and %d invalid files.\n",
+        cfg.fill_valid_run, cfg.fill_invalid_run);
+    else
+      fprintf(fp, "valid and invalid files drawn at random.\n");
+    size_distrib_show(fp, "Fill file", &cfg.fill_sizes);
+  }
+  else
+    fprintf(fp, "Contiguous fill: one valid and one invalid file.\n");
+
+  if(cfg.aging_written || cfg.aging_extents > 0)
+  {
+    fprintf(fp, "Aging: churn on %d files (fill file sizes) until ",
+      cfg.aging_files);
+    if(cfg.aging_extents > 0)
+      fprintf(fp, "%.2lf extents per file%s", cfg.aging_extents,
+        cfg.aging_written ? " or " : ".\n");
+    if(cfg.aging_written)
+      fprintf(fp, "%.1lf MB written.\n", cfg.aging_written / MEGABYTE);
+  }
+  else
+    fprintf(fp, "Aging: disabled.\n");
+
+  if(cfg.interval_ms)
+    fprintf(fp, "Interval statistics: every %d ms to %s.\n", cfg.interval_ms,
+      cfg.interval_path);
+  else
+    fprintf(fp, "Interval statistics: disabled.\n");
+
+  if(cfg.record_path[0])
+    fprintf(fp, "Operations recorded to %s.\n", cfg.record_path);
+
+  if(io_engine == IO_ENGINE_URING)
+    fprintf(fp, "I/O engine: io_uring, queue depth %d (unbuffered I/O "
+      "only).\n", io_queue_depth);
+  else
+    fprintf(fp, "I/O engine: sync.\n");
     
   return 0;
 }
@@ -152,6 +236,30 @@ int ffsmark_cli_set_location(char *param)
 
 int ffsmark_core_verb_report(FILE *fp)
 {
+  if(open_flags & O_DIRECT)
+    fprintf(fp, "\nDirect I/O: %d I/Os fell back to buffered\n",
+      direct_fallbacks);
+
+
+  if(aging_done)
+  {
+    fprintf(fp, "\nAging (before the benchmark):\n");
+    fprintf(fp, "\t%.2lf megabytes written in %.3lf seconds (%.2lf megabytes"
+      " per second)\n", aging_res.written / MEGABYTE, aging_res.seconds,
+      aging_res.seconds > 0 ? aging_res.written / MEGABYTE /
+      aging_res.seconds : 0);
+    fprintf(fp, "\t%llu creates, %llu appends, %llu deletes, %d files "
+      "left\n", (unsigned long long)aging_res.creates,
+      (unsigned long long)aging_res.appends,
+      (unsigned long long)aging_res.deletes, aging_res.live);
+    if(aging_res.extents >= 0)
+      fprintf(fp, "\t%.2lf extents per file%s\n", aging_res.extents,
+        aging_res.missed ? " (target not reached)" : "");
+    if(cfg.flashmon_enabled)
+      fprintf(fp, "\tPage write num.: %d, erase num.: %d\n",
+        aging_write_num, aging_flash_ei.total_erase_num);
+  }
+
   if(cfg.flashmon_enabled)
   {
     fprintf(fp, "\nFlash:\n");
@@ -171,6 +279,25 @@ int ffsmark_core_verb_report(FILE *fp)
   return 0;
 }
 
+/**
+ * Flash counters of the iteration, for the run summary
+ */
+int ffsmark_core_results()
+{
+  if(cfg.flashmon_enabled)
+  {
+    results_add("flash page writes", post_bench_write_num);
+    results_add("flash page reads", post_bench_read_num);
+    results_add("flash erases", post_bench_flash_ei.total_erase_num);
+    results_add("flash mean erase counter",
+      post_bench_flash_ei.mean_erase_counter);
+    results_add("flash erase counter delta", post_bench_flash_ei.erase_delta);
+    results_add("flash erase counter stdev", post_bench_flash_ei.erase_stdev);
+  }
+
+  return 0;
+}
+
 int cli_set_drop_creation(char *param)
 {
   if (param && !strcmp(param, "true"))
@@ -247,10 +374,217 @@ int cli_set_fill_invalid_transaction(char *param)
   return 1;
 }
 
+int cli_set_fill_threads(char *param)
+{
+  int val = param ? atoi(param) : 0;
+
+  if(val > 0)
+    cfg.fill_threads = val;
+  else
+    fprintf(stderr, "Error: please indicate a number of threads > 0\n");
+
+  return 1;
+}
+
+int cli_set_fill_fallocate(char *param)
+{
+  if (param && !strcmp(param, "true"))
+    cfg.fill_fallocate = 1;
+  else if (param && !strcmp(param, "false"))
+    cfg.fill_fallocate = 0;
+  else
+    fprintf (stderr, "Error: please indicate true or false\n");
+
+  return 1;
+}
+
+int cli_set_fill_mode(char *param)
+{
+  if (param && !strcmp(param, "contiguous"))
+    cfg.fill_fragmented = 0;
+  else if (param && !strcmp(param, "fragmented"))
+    cfg.fill_fragmented = 1;
+  else
+    fprintf (stderr, "Error: please indicate contiguous or fragmented\n");
+
+  return 1;
+}
+
+int cli_set_fill_files(char *param)
+{
+  int low, high, len;
+
+  if(param && sscanf(param, "%d %d%n", &low, &high, &len) == 2 && low > 0
+    && high >= low)
+  {
+    /* optional distribution within the bounds */
+    while(param[len] == ' ')
+      len++;
+    if(param[len] && size_distrib_parse(param + len, &cfg.fill_sizes) != 0)
+      return 1;
+    cfg.fill_low = low;
+    cfg.fill_high = high;
+  }
+  else
+    fprintf(stderr, "Error: please indicate the lowest and highest sizes of "
+      "the fill files\n");
+
+  return 1;
+}
+
+int cli_set_fill_pattern(char *param)
+{
+  int valid, invalid;
+
+  if(param && !strcmp(param, "random"))
+    cfg.fill_valid_run = cfg.fill_invalid_run = 0;
+  else if(param && sscanf(param, "%d:%d", &valid, &invalid) == 2
+    && valid > 0 && invalid > 0)
+  {
+    cfg.fill_valid_run = valid;
+    cfg.fill_invalid_run = invalid;
+  }
+  else
+    fprintf(stderr, "Error: please indicate random or valid:invalid file "
+      "runs\n");
+
+  return 1;
+}
+
+int cli_set_aging_written(char *param)
+{
+  double mb;
+
+  if(param && sscanf(param, "%lf", &mb) == 1 && mb >= 0)
+    cfg.aging_written = (uint64_t)(mb * MEGABYTE);
+  else
+    fprintf(stderr, "Error: please indicate a number of MB (0 to "
+      "disable)\n");
+
+  return 1;
+}
+
+int cli_set_aging_fragmentation(char *param)
+{
+  double extents;
+
+  if(param && sscanf(param, "%lf", &extents) == 1 && extents >= 0)
+    cfg.aging_extents = extents;
+  else
+    fprintf(stderr, "Error: please indicate a number of extents per file "
+      "(0 to disable)\n");
+
+  return 1;
+}
+
+int cli_set_aging_files(char *param)
+{
+  int val = param ? atoi(param) : 0;
+
+  if(val > 0)
+    cfg.aging_files = val;
+  else
+    fprintf(stderr, "Error: please indicate a number of files > 0\n");
+
+  return 1;
+}
+
+int cli_set_interval(char *param)
+{
+  char path[128];
+  int ms;
+
+  if(param && sscanf(param, "%d %127s", &ms, path) == 2 && ms > 0)
+  {
+    cfg.interval_ms = ms;
+    strcpy(cfg.interval_path, path);
+  }
+  else if(param && atoi(param) == 0)
+    cfg.interval_ms = 0;
+  else
+    fprintf(stderr, "Error: please indicate an interval in ms and a CSV "
+      "file (0 to disable)\n");
+
+  return 1;
+}
+
+int cli_set_record(char *param)
+{
+  if(param && !strcmp(param, "off"))
+    cfg.record_path[0] = '\0';
+  else if(param && strlen(param) < sizeof(cfg.record_path))
+    strcpy(cfg.record_path, param);
+  else
+    fprintf(stderr, "Error: please indicate a trace file or off\n");
+
+  return 1;
+}
+
+/**
+ * Flash counters appended to the terse report line, in the order of the
+ * verbose report, nothing when flashmon is disabled
+ */
 int ffsmark_core_terse_report(FILE *fp)
 {
-  fprintf(stderr, "Terse report not available\n");
-  return -1;
+  if(cfg.flashmon_enabled)
+    fprintf(fp, " %d %d %d %lf %d %lf", post_bench_write_num,
+      post_bench_read_num, post_bench_flash_ei.total_erase_num,
+      post_bench_flash_ei.mean_erase_counter,
+      post_bench_flash_ei.erase_delta, post_bench_flash_ei.erase_stdev);
+
+  return 0;
+}
+
+/**
+ * Configuration and results of the core as report fields: the flash and
+ * aging fields are always present (null when disabled) so that the CSV
+ * columns only depend on the version
+ */
+int ffsmark_core_report_fields()
+{
+  report_string("config.location", cfg.location);
+  report_string("config.io_engine",
+    (io_engine == IO_ENGINE_URING) ? "io_uring" : "sync");
+  report_integer("config.io_queue_depth", io_queue_depth);
+  report_integer("config.direct", (open_flags & O_DIRECT) != 0);
+  report_integer("config.flashmon", cfg.flashmon_enabled);
+  report_integer("config.drop_creation", cfg.drop_creation);
+  report_integer("config.drop_transactions", cfg.drop_transaction);
+  report_number("config.fill.valid_creation", cfg.fill_valid_creation);
+  report_number("config.fill.invalid_creation", cfg.fill_invalid_creation);
+  report_number("config.fill.valid_transactions",
+    cfg.fill_valid_transaction);
+  report_number("config.fill.invalid_transactions",
+    cfg.fill_invalid_transaction);
+  report_integer("config.fill.fragmented", cfg.fill_fragmented);
+  report_integer("config.aging.written", cfg.aging_written);
+  report_number("config.aging.extents", cfg.aging_extents);
+  report_integer("config.aging.files", cfg.aging_files);
+
+  report_integer("direct_fallbacks", direct_fallbacks);
+
+  report_number("aging.written_mb",
+    aging_done ? aging_res.written / MEGABYTE : NAN);
+  report_number("aging.seconds", aging_done ? aging_res.seconds : NAN);
+  report_number("aging.extents_per_file",
+    (aging_done && aging_res.extents >= 0) ? aging_res.extents : NAN);
+  report_number("aging.files", aging_done ? aging_res.live : NAN);
+  report_number("aging.target_missed", aging_done ? aging_res.missed : NAN);
+
+  report_number("flash.page_writes",
+    cfg.flashmon_enabled ? post_bench_write_num : NAN);
+  report_number("flash.page_reads",
+    cfg.flashmon_enabled ? post_bench_read_num : NAN);
+  report_number("flash.erases",
+    cfg.flashmon_enabled ? post_bench_flash_ei.total_erase_num : NAN);
+  report_number("flash.mean_erase_counter",
+    cfg.flashmon_enabled ? post_bench_flash_ei.mean_erase_counter : NAN);
+  report_number("flash.erase_counter_delta",
+    cfg.flashmon_enabled ? post_bench_flash_ei.erase_delta : NAN);
+  report_number("flash.erase_counter_stdev",
+    cfg.flashmon_enabled ? post_bench_flash_ei.erase_stdev : NAN);
+
+  return 0;
 }
 
   int flashmon_enabled;
@@ -269,10 +603,96 @@ int ffsmark_reset_config()
   cfg.fill_invalid_creation = cfg.fill_valid_creation = 0;
   cfg.fill_invalid_transaction = cfg.fill_valid_transaction = 0;
   strcpy(cfg.location, "./");
+  cfg.interval_ms = 0;
+  cfg.record_path[0] = '\0';
+  cfg.fill_threads = 1;
+  cfg.fill_fallocate = 0;
+  cfg.fill_fragmented = 0;
+  cfg.fill_low = 4096;
+  cfg.fill_high = 65536;
+  cfg.fill_sizes.type = SIZE_UNIFORM;
+  cfg.fill_valid_run = cfg.fill_invalid_run = 0;
+  cfg.aging_written = 0;
+  cfg.aging_extents = 0;
+  cfg.aging_files = 1000;
   
   return 0;
 }
 
+/**
+ * Aging phase, in a new directory of the location, its flash operations
+ * being counted apart from the benchmark ones. The directory is removed
+ * after the run, so that each 'run' (and each 'set repeat' iteration)
+ * ages the file system from the same state.
+ */
+static int age()
+{
+  char *dir = aging_dir;
+  int ret;
+
+  do
+    snprintf(dir, sizeof(aging_dir), "%s/%s.%d", cfg.location,
+      AGING_DIR_NAME, rand()%50000);
+  while(access(dir, F_OK) != -1);
+
+  if(cfg.flashmon_enabled && flashmon_ctrl_reset() != 0)
+    return -1;
+
+  if(size_distrib_build(&cfg.fill_sizes, cfg.fill_low, cfg.fill_high) != 0)
+    return -1;
+  ret = aging_run(dir, cfg.aging_written, cfg.aging_extents,
+    cfg.aging_files, &cfg.fill_sizes, cfg.fill_low, cfg.fill_high,
+    &aging_res);
+  size_distrib_free(&cfg.fill_sizes);
+
+  if(ret != 0)
+  {
+    fprintf(stderr, "Error aging the file system\n");
+    return -1;
+  }
+  aging_done = 1;
+
+  if(cfg.flashmon_enabled)
+  {
+    aging_write_num = flashmon_ctrl_get_write_num();
+    if(flashmon_ctrl_get_erase_info(&aging_flash_ei) == -1)
+      return -1;
+  }
+
+  return 0;
+}
+
+/**
+ * Fragmented variant of fill_valid_invalid(): small valid and invalid
+ * files in a new directory of the location
+ */
+static int fill_valid_invalid_fragmented(uint64_t valid_size,
+  uint64_t invalid_size)
+{
+  char dir[256];
+  int ret;
+
+  if(!valid_size && !invalid_size)
+    return 0;
+
+  do
+    snprintf(dir, sizeof(dir), "%s/%s.%d", cfg.location, FILL_DIR_NAME,
+      rand()%50000);
+  while(access(dir, F_OK) != -1);
+
+  if(size_distrib_build(&cfg.fill_sizes, cfg.fill_low, cfg.fill_high) != 0)
+    return -1;
+
+  ret = fill_fragmented(dir, valid_size, invalid_size, &cfg.fill_sizes,
+    cfg.fill_low, cfg.fill_high, cfg.fill_valid_run, cfg.fill_invalid_run,
+    cfg.fill_threads);
+  size_distrib_free(&cfg.fill_sizes);
+
+  if(ret != 0)
+    fprintf(stderr, "Error creating fragmented valid/invalid data\n");
+  return ret;
+}
+
 /**
  * Fill the file system at path with valid data and invalid data
  * (ratios are floating point percentages between 0 and 1)
@@ -294,6 +714,9 @@ static int fill_valid_invalid(char *path, double valid_ratio,
   valid_size = (uint64_t)(valid_ratio*((double)(free_space)));
   invalid_size = (uint64_t)(invalid_ratio*((double)(free_space)));
 
+  if(cfg.fill_fragmented)
+    return fill_valid_invalid_fragmented(valid_size, invalid_size);
+
   sprintf(valid_path, "%s/%s.%d", cfg.location, VALID_FILE_NAME, 
     rand()%50000);
   sprintf(invalid_path, "%s/%s.%d", cfg.location, INVALID_FILE_NAME,
@@ -334,112 +757,15 @@ static int fill_valid_invalid(char *path, double valid_ratio,
  */
 static int ffsmark_core_create_file(char *path, uint64_t size)
 {
-  //FILE *src, *dest;
-  int src, dest;
-  char buf[4096];
-  int i, rest, r, ret=-1;
-  
-  //~ src = fopen(RANDOM_DATA_SRC, "r");
-  //~ if(src == NULL)
-  //~ {
-    //~ fprintf(stderr, "Error openning %s\n", RANDOM_DATA_SRC);
-    //~ perror("fopen");
-    //~ return -1;
-  //~ }
-  
-  src = open(RANDOM_DATA_SRC, O_RDONLY);
-  if(src == -1)
-  {
-    perror("open");
-    return -1;
-  }
-  
-  //~ dest = fopen(path, "w+");
-  //~ if(dest == NULL)
-  //~ {
-    //~ fprintf(stderr, "Error openning %s for creation\n", path);
-    //~ perror("fopen");
-    //~ return -1;
-  //~ }
-  
-  dest = open(path, O_RDWR | O_CREAT | O_EXCL, S_IRWXU);
-  if(dest == -1)
-  {
-    perror("open");
-    return -1;
-  }
-  
-  //~ for(i=0; i<(size/4096); i++)
-  //~ {
-    //~ if((r = fread(buf, 4096, 1, src)) != 1)
-    //~ {
-      //~ fprintf(stderr, "read : %d\n", r);
-      //~ perror("fread");
-      //~ goto out_close;
-    //~ }
-    //~ 
-    //~ if(fwrite(buf, 4096, 1, dest) != 1)
-    //~ {
-      //~ perror("fwrite");
-      //~ goto out_close;
-    //~ }
-  //~ }
-  
-  for(i=0; i<(size/4096); i++)
-  {
-    if((r = read(src, buf, 4096)) != 4096)
-    {
-      fprintf(stderr, "read : %d\n", r);
-      perror("read");
-      goto out_close;
-    }
-    
-    if((r = write(dest, buf, 4096)) != 4096)
-    {
-      fprintf(stderr, "write : %d\n", r);
-      perror("write");
-      goto out_close;
-    }
-  }
-  
-  rest = size % 4096;
-  //~ if((r = fread(buf, rest, 1, src)) != 1)
-  //~ {
-    //~ fprintf(stderr, "read : %d\n", r);
-    //~ perror("fread");
-    //~ goto out_close;
-  //~ }
-  //~ 
-  //~ if(fwrite(buf, rest, 1, dest) != 1)
-  //~ {
-    //~ perror("fwrite");
-    //~ goto out_close;
-  //~ }
-  
-  if((r = read(src, buf, rest)) != rest)
-  {
-    fprintf(stderr, "read : %d\n", r);
-    perror("read");
-    goto out_close;
-  }
-  
-  if((r = write(dest, buf, rest)) != rest)
-  {
-    fprintf(stderr, "write : %d\n", r);
-    perror("write");
-    goto out_close;
-  }
-  
-  ret = 0;
-out_close:
-  //~ fclose(dest);
-  //~ fclose(src);
-  close(dest);
-  close(src);
-  return ret;
+  return fill_file(path, size, cfg.fill_threads, cfg.fill_fallocate);
 }
 
 int ffsmark_hooks_pre_subdirs_creation() {
+  aging_done = 0;
+  if(cfg.aging_written || cfg.aging_extents > 0)
+    if(age() != 0)
+      return -1;
+
   if(cfg.fill_invalid_creation || cfg.fill_valid_creation)
   {
     printf("Creating valid (%lf) and invalid (%lf) data for creation "
@@ -468,6 +794,10 @@ int ffsmark_hooks_pre_subdirs_creation() {
 int ffsmark_hooks_pre_files_creation()
 {
   //printf("ffsmark_hooks_pre_files_creation\n");
+  if(cfg.record_path[0])
+    if(optrace_start(cfg.record_path) != 0)
+      return -1;
+
   return 0;
 }
 
@@ -488,6 +818,10 @@ int ffsmark_hooks_pre_transactions()
     if(syscaches_drop_caches())
         return -1;
   }
+
+  if(cfg.interval_ms)
+    if(interval_start(cfg.interval_path, cfg.interval_ms) != 0)
+      return -1;
 /*  if(cfg.flashmon_enabled)
     if(flashmon_ctrl_reset() != 0)
       return -1;
@@ -498,12 +832,14 @@ int ffsmark_hooks_pre_transactions()
 int ffsmark_hooks_pre_files_deletion()
 {
   //printf("ffsmark_hooks_pre_files_deletion\n");
+  interval_stop();
   return 0;
 }
 
 int ffsmark_hooks_pre_subdirs_deletion()
 {
   //printf("ffsmark_hooks_pre_subdirs_deletion\n");
+  optrace_stop();
   return 0;
 }
 
@@ -518,9 +854,128 @@ int ffsmark_hooks_post_subdirs_deletion()
     if(flashmon_ctrl_get_erase_info(&post_bench_flash_ei) == -1)
       return -1;
   }
+
+  if(aging_done && aging_clean(aging_dir) != 0)
+  {
+    fprintf(stderr, "Error removing %s\n", aging_dir);
+    return -1;
+  }
   return 0;
 }
 
+/**
+ * Alignment (in bytes) required by direct I/O for files created in path:
+ * statx() DIOALIGN when the kernel reports it, then the logical block size
+ * of the underlying block device, then a 512 bytes default. The result is
+ * never lower than the page size so that buffers are page aligned.
+ */
+int ffsmark_direct_alignment(char *path)
+{
+  char probe[256], dev[64];
+  struct stat s;
+  int align = 0, fd, page = sysconf(_SC_PAGESIZE);
+#ifdef STATX_DIOALIGN
+  struct statx sx;
+#endif
+
+  direct_fallbacks = 0;
+
+  snprintf(probe, sizeof(probe), "%s/%s", path, ALIGN_FILE_NAME);
+  fd = open(probe, O_RDWR | O_CREAT, S_IRWXU);
+  if(fd != -1)
+  {
+#ifdef STATX_DIOALIGN
+    if(statx(fd, "", AT_EMPTY_PATH, STATX_DIOALIGN, &sx) == 0 &&
+      (sx.stx_mask & STATX_DIOALIGN) && sx.stx_dio_offset_align)
+    {
+      align = sx.stx_dio_offset_align;
+      if((int)sx.stx_dio_mem_align > align)
+        align = sx.stx_dio_mem_align;
+    }
+#endif
+    close(fd);
+    unlink(probe);
+  }
+
+  if(!align && stat(path, &s) == 0)
+  {
+    snprintf(dev, sizeof(dev), "/dev/block/%u:%u", major(s.st_dev),
+      minor(s.st_dev));
+    fd = open(dev, O_RDONLY);
+    if(fd != -1)
+    {
+      if(ioctl(fd, BLKSSZGET, &align) != 0)
+        align = 0;
+      close(fd);
+    }
+  }
+
+  if(!align)
+    align = DEFAULT_DIRECT_ALIGN;
+
+  return (align > page) ? align : page;
+}
+
+void ffsmark_core_direct_fallback()
+{
+  __sync_fetch_and_add(&direct_fallbacks, 1);
+}
+
+/**
+ * open() retrying without O_DIRECT if the file system refuses it
+ */
+int ffsmark_core_open(char *path, int flags, int mode)
+{
+  int fd;
+
+  fd = open(path, flags, mode);
+  if(fd == -1 && errno == EINVAL && (flags & O_DIRECT))
+  {
+    ffsmark_core_direct_fallback();
+    fd = open(path, flags & ~O_DIRECT, mode);
+  }
+
+  return fd;
+}
+
+/**
+ * write()/read() switching the file to buffered I/O when a direct I/O is
+ * refused (EINVAL), and retrying it
+ */
+ssize_t ffsmark_core_write(int fd, void *buf, size_t count)
+{
+  ssize_t ret;
+  int fl;
+
+  ret = write(fd, buf, count);
+  if(ret == -1 && errno == EINVAL && 
+    ((fl = fcntl(fd, F_GETFL)) & O_DIRECT))
+  {
+    ffsmark_core_direct_fallback();
+    if(fcntl(fd, F_SETFL, fl & ~O_DIRECT) == 0)
+      ret = write(fd, buf, count);
+  }
+
+  return ret;
+}
+
+ssize_t ffsmark_core_read(int fd, void *buf, size_t count)
+{
+  ssize_t ret;
+  int fl;
+
+  ret = read(fd, buf, count);
+  if(ret == -1 && errno == EINVAL && 
+    ((fl = fcntl(fd, F_GETFL)) & O_DIRECT))
+  {
+    ffsmark_core_direct_fallback();
+    if(fcntl(fd, F_SETFL, fl & ~O_DIRECT) == 0)
+      ret = read(fd, buf, count);
+  }
+
+  return ret;
+}
+
 int cli_set_direct(char *param) {
   if (param && !strcmp(param, "true"))
     open_flags |= O_DIRECT;
@@ -532,6 +987,40 @@ int cli_set_direct(char *param) {
   return 1;
 }
 
+int cli_set_engine(char *param)
+{
+  if (param && !strcmp(param, "sync"))
+    io_engine = IO_ENGINE_SYNC;
+  else if (param && !strcmp(param, "uring"))
+  {
+    /* check that the running kernel lets us set up a ring */
+    if(uring_engine_setup(io_queue_depth) == 0)
+    {
+      uring_engine_teardown();
+      io_engine = IO_ENGINE_URING;
+    }
+    else
+      fprintf(stderr, "Error: io_uring is not available\n");
+  }
+  else
+    fprintf (stderr, "Error: please indicate sync or uring\n");
+
+  return 1;
+}
+
+int cli_set_queue_depth(char *param)
+{
+  int val;
+
+  if (param && (val = atoi(param)) > 0 && val <= URING_ENGINE_MAX_DEPTH)
+    io_queue_depth = val;
+  else
+    fprintf(stderr, "Error: queue depth must be between 1 and %d\n",
+      URING_ENGINE_MAX_DEPTH);
+
+  return 1;
+}
+
 int cli_set_sync(char *param) {
   if (param && !strcmp(param, "true"))
     open_flags |= O_SYNC;
@@ -26,6 +26,7 @@
 #define FFSMARK_CORE_H
 
 #include <stdio.h>
+#include <sys/types.h>
 
 int cli_set_flashmon(char *param);
 int cli_set_drop_creation(char *param);
@@ -34,12 +35,32 @@ int cli_set_fill_valid_creation(char *param);
 int cli_set_fill_valid_transaction(char *param);
 int cli_set_fill_invalid_creation(char *param);
 int cli_set_fill_invalid_transaction(char *param);
+int cli_set_fill_threads(char *param);
+int cli_set_fill_fallocate(char *param);
+int cli_set_fill_mode(char *param);
+int cli_set_fill_files(char *param);
+int cli_set_fill_pattern(char *param);
+int cli_set_aging_written(char *param);
+int cli_set_aging_fragmentation(char *param);
+int cli_set_aging_files(char *param);
 int ffsmark_cli_set_location(char *param);
+int cli_set_engine(char *param);
+int cli_set_queue_depth(char *param);
+int cli_set_interval(char *param);
+int cli_set_record(char *param);
 int ffsmark_reset_config();
 
+int ffsmark_direct_alignment(char *path);
+int ffsmark_core_open(char *path, int flags, int mode);
+ssize_t ffsmark_core_write(int fd, void *buf, size_t count);
+ssize_t ffsmark_core_read(int fd, void *buf, size_t count);
+void ffsmark_core_direct_fallback();
+
 int ffsmark_core_cli_show(FILE *fp);
 int ffsmark_core_verb_report(FILE *fp);
 int ffsmark_core_terse_report(FILE *fp);
+int ffsmark_core_results();
+int ffsmark_core_report_fields();
 
 /**
  * The hooks are called in that order :
@@ -65,6 +86,11 @@ int ffsmark_hooks_pre_files_deletion();
 int ffsmark_hooks_pre_subdirs_deletion();
 int ffsmark_hooks_post_subdirs_deletion();
 
+#define IO_ENGINE_SYNC    0
+#define IO_ENGINE_URING   1
+
 extern int open_flags;
+extern int io_engine;
+extern int io_queue_depth;
 
 #endif /* FFSMARK_CORE_H */
@@ -0,0 +1,389 @@
+/*
+ * FFSMark
+ * Pierre Olivier <pierre.olivier@univ-brest.fr>
+ *
+ * Copyright (c) of University of Occidental Britanny (UBO) <pierre.olivier@univ-brest.fr>, 2015.
+ *
+ *	This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ * NO WARRANTY. THIS SOFTWARE IS FURNISHED ON AN "AS IS" BASIS.
+ * UNIVERSITY OF OCCIDENTAL BRITANNY MAKES NO WARRANTIES OF ANY KIND, EITHER
+ * EXPRESSED OR IMPLIED AS TO THE MATTER INCLUDING, BUT NOT LIMITED
+ * TO: WARRANTY OF FITNESS FOR PURPOSE OR MERCHANTABILITY, EXCLUSIVITY
+ * OF RESULTS OR RESULTS OBTAINED FROM USE OF THIS SOFTWARE. 
+ * See the GNU General Public License for more details.
+ *
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define _GNU_SOURCE
+#include "fill.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/stat.h>
+
+#include "datagen.h"
+#include "latency.h"
+
+#define MEGABYTE            (1024.0*1024.0)
+#define PROGRESS_PERIOD_NS  1000000000ULL
+#define POLL_US             100000
+#define FILL_FILE_NAME      "f%d"
+
+typedef struct
+{
+  int size;
+  int invalid;
+} fill_entry;
+
+typedef struct
+{
+  int fd;                     /* contiguous: the file */
+  char *dir;                  /* fragmented: directory of the files */
+  fill_entry *files;
+  int nfiles;
+  volatile int next;          /* next file to write */
+  uint64_t size;              /* bytes to write in total */
+  uint64_t seed;
+  int threads;
+  volatile uint64_t done;     /* bytes written by all threads */
+  volatile int running;       /* writer threads not finished */
+  volatile int failed;
+} fill_state;
+
+typedef struct
+{
+  fill_state *state;
+  int id;
+  void *buf;                  /* FILL_BLOCK bytes, page aligned */
+  pthread_t thread;
+} fill_writer;
+
+/**
+ * Contiguous fill: writer 'id' writes blocks id, id + threads, ... of the
+ * file
+ */
+static void *fill_stripes(void *arg)
+{
+  fill_writer *w = arg;
+  fill_state *s = w->state;
+  uint64_t block, offset;
+  size_t len;
+
+  for(block = w->id; !s->failed && (offset = block * FILL_BLOCK) < s->size;
+    block += s->threads)
+  {
+    len = (s->size - offset < FILL_BLOCK) ? s->size - offset : FILL_BLOCK;
+    datagen_fill(w->buf, len, s->seed, offset / sizeof(uint64_t), 0);
+
+    if(pwrite(s->fd, w->buf, len, offset) != (ssize_t)len)
+    {
+      perror("pwrite");
+      s->failed = 1;
+      break;
+    }
+
+    __sync_add_and_fetch(&s->done, len);
+  }
+
+  return NULL;
+}
+
+/**
+ * Fragmented fill: writers take the next file of the list, files being
+ * created in list order as long as there is a single writer
+ */
+static void *fill_files(void *arg)
+{
+  fill_writer *w = arg;
+  fill_state *s = w->state;
+  char path[256];
+  int i, fd, len, done;
+
+  while(!s->failed && (i = __sync_fetch_and_add(&s->next, 1)) < s->nfiles)
+  {
+    snprintf(path, sizeof(path), "%s/" FILL_FILE_NAME, s->dir, i);
+    if((fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, S_IRWXU)) == -1)
+    {
+      perror("open");
+      s->failed = 1;
+      break;
+    }
+
+    for(done = 0; done < s->files[i].size; done += len)
+    {
+      len = (s->files[i].size - done < FILL_BLOCK) ?
+        s->files[i].size - done : FILL_BLOCK;
+      datagen_fill(w->buf, len, datagen_word(s->seed, i),
+        done / sizeof(uint64_t), 0);
+
+      if(write(fd, w->buf, len) != len)
+      {
+        perror("write");
+        s->failed = 1;
+        break;
+      }
+    }
+
+    close(fd);
+    __sync_add_and_fetch(&s->done, s->files[i].size);
+  }
+
+  return NULL;
+}
+
+static void *fill_writer_run(void *arg)
+{
+  fill_writer *w = arg;
+
+  if(w->state->fd != -1)
+    fill_stripes(w);
+  else
+    fill_files(w);
+
+  __sync_sub_and_fetch(&w->state->running, 1);
+  return NULL;
+}
+
+static void fill_progress(fill_state *s, uint64_t start, int last)
+{
+  double seconds = (latency_now() - start) / 1e9;
+
+  printf("\r\t%.1lf/%.1lf MB (%3d%%), %.2lf MB/s", s->done / MEGABYTE,
+    s->size / MEGABYTE, s->size ? (int)(100 * s->done / s->size) : 100,
+    seconds > 0 ? s->done / MEGABYTE / seconds : 0);
+  if(last)
+    printf(", %.3lf seconds\n", seconds);
+  fflush(stdout);
+}
+
+/**
+ * Run the writer threads, printing the progress every second until they
+ * are done, then sync the written data
+ */
+static int fill_run(fill_state *s)
+{
+  fill_writer *writers;
+  uint64_t start, last;
+  int i, started, dirfd;
+
+  s->threads = (s->threads > 0) ? s->threads : 1;
+  if((writers = calloc(s->threads, sizeof(fill_writer))) == NULL)
+    return -1;
+
+  start = last = latency_now();
+
+  s->running = s->threads;
+  for(i = 0, started = 0; i < s->threads; i++, started++)
+  {
+    writers[i].state = s;
+    writers[i].id = i;
+    if(posix_memalign(&writers[i].buf, 4096, FILL_BLOCK) != 0
+      || pthread_create(&writers[i].thread, NULL, fill_writer_run,
+      &writers[i]))
+    {
+      fprintf(stderr, "Error: cannot start fill writer %d\n", i);
+      free(writers[i].buf);
+      s->failed = 1;
+      __sync_sub_and_fetch(&s->running, s->threads - i);
+      break;
+    }
+  }
+
+  while(s->running > 0)
+  {
+    usleep(POLL_US);
+    if(latency_now() - last >= PROGRESS_PERIOD_NS)
+    {
+      fill_progress(s, start, 0);
+      last = latency_now();
+    }
+  }
+
+  for(i = 0; i < started; i++)
+  {
+    pthread_join(writers[i].thread, NULL);
+    free(writers[i].buf);
+  }
+  free(writers);
+
+  if(!s->failed)
+  {
+    if(s->fd != -1)
+      s->failed = (fsync(s->fd) != 0);
+    else if((dirfd = open(s->dir, O_RDONLY | O_DIRECTORY)) != -1)
+    {
+      s->failed = (syncfs(dirfd) != 0);
+      close(dirfd);
+    }
+    else
+      s->failed = 1;
+
+    if(s->failed)
+      perror("sync");
+  }
+
+  if(!s->failed)
+    fill_progress(s, start, 1);
+  else
+    printf("\n");
+
+  return s->failed ? -1 : 0;
+}
+
+int fill_file(char *path, uint64_t size, int threads, int preallocate)
+{
+  fill_state s;
+  int ret;
+
+  memset(&s, 0, sizeof(s));
+  s.size = size;
+  s.threads = threads;
+  s.seed = ((uint64_t)rand() << 32) ^ (uint64_t)rand();
+
+  if((s.fd = open(path, O_RDWR | O_CREAT | O_EXCL, S_IRWXU)) == -1)
+  {
+    perror("open");
+    return -1;
+  }
+
+  /* not supported by UBIFS or JFFS2: the data is then simply written */
+  if(preallocate && size && fallocate(s.fd, 0, 0, size) != 0
+    && errno != EOPNOTSUPP)
+  {
+    perror("fallocate");
+    close(s.fd);
+    return -1;
+  }
+
+  printf("Filling %s with %.1lf MB (%d writer%s)\n", path, size / MEGABYTE,
+    threads, (threads > 1) ? "s" : "");
+
+  ret = fill_run(&s);
+  close(s.fd);
+
+  return ret;
+}
+
+/**
+ * Size of the next file, drawn from stream s (benchmark generator if NULL)
+ */
+int fill_size(size_distrib *sizes, int low, int high, distrib_stream *s)
+{
+  if(sizes->type == SIZE_UNIFORM)
+    return low + (int)((s ? distrib_stream_uniform(s) : distrib_uniform())
+      * (high - low + 1));
+
+  return size_distrib_draw(sizes, s);
+}
+
+/**
+ * Kind of the next file: 'valid_run' valid files then 'invalid_run'
+ * invalid ones, or drawn at random in proportion of the sizes to fill
+ */
+static int next_invalid(uint64_t valid_left, uint64_t invalid_left,
+  double invalid_share, int valid_run, int invalid_run, int n,
+  distrib_stream *rnd)
+{
+  if(!valid_left || !invalid_left)
+    return invalid_left > 0;
+
+  if(valid_run + invalid_run == 0)
+    return distrib_stream_uniform(rnd) < invalid_share;
+
+  return (n % (valid_run + invalid_run)) >= valid_run;
+}
+
+int fill_fragmented(char *dir, uint64_t valid_size, uint64_t invalid_size,
+  size_distrib *sizes, int low, int high, int valid_run, int invalid_run,
+  int threads)
+{
+  fill_state s;
+  distrib_stream rnd;
+  fill_entry *grown;
+  uint64_t valid_left = valid_size, invalid_left = invalid_size, *left;
+  double invalid_share = (double)invalid_size / (valid_size + invalid_size);
+  int capacity = 0, i, invalid = 0, removed = 0, ret, dirfd;
+  char path[256];
+
+  memset(&s, 0, sizeof(s));
+  s.fd = -1;
+  s.dir = dir;
+  s.size = valid_size + invalid_size;
+  s.threads = threads;
+  s.seed = ((uint64_t)rand() << 32) ^ (uint64_t)rand();
+
+  /* the whole layout is decided before writing anything, from a stream of
+     its own: a transaction time fill runs once the transactions are drawn */
+  rnd.seed = ~s.seed;
+  rnd.n = 0;
+  while(valid_left || invalid_left)
+  {
+    if(s.nfiles == capacity)
+    {
+      capacity = capacity ? capacity * 2 : 1024;
+      if((grown = realloc(s.files, capacity * sizeof(fill_entry))) == NULL)
+      {
+        fprintf(stderr, "Error: cannot allocate the fill layout\n");
+        free(s.files);
+        return -1;
+      }
+      s.files = grown;
+    }
+
+    s.files[s.nfiles].invalid = next_invalid(valid_left, invalid_left,
+      invalid_share, valid_run, invalid_run, s.nfiles, &rnd);
+    left = s.files[s.nfiles].invalid ? &invalid_left : &valid_left;
+    s.files[s.nfiles].size = fill_size(sizes, low, high, &rnd);
+    if((uint64_t)s.files[s.nfiles].size > *left)
+      s.files[s.nfiles].size = *left;
+    *left -= s.files[s.nfiles].size;
+    invalid += s.files[s.nfiles++].invalid;
+  }
+
+  if(mkdir(dir, S_IRWXU) != 0 && errno != EEXIST)
+  {
+    perror("mkdir");
+    free(s.files);
+    return -1;
+  }
+
+  printf("Filling %s with %.1lf MB in %d files, %d of them then deleted "
+    "(%d writer%s)\n", dir, s.size / MEGABYTE, s.nfiles, invalid, threads,
+    (threads > 1) ? "s" : "");
+
+  if((ret = fill_run(&s)) == 0)
+  {
+    for(i = 0; i < s.nfiles; i++)
+    {
+      if(!s.files[i].invalid)
+        continue;
+      snprintf(path, sizeof(path), "%s/" FILL_FILE_NAME, dir, i);
+      removed += (unlink(path) == 0);
+    }
+
+    /* the deletions reach the flash too */
+    if((dirfd = open(dir, O_RDONLY | O_DIRECTORY)) != -1)
+    {
+      syncfs(dirfd);
+      close(dirfd);
+    }
+
+    printf("\t%d invalid files deleted, %d valid files left in %s\n",
+      removed, s.nfiles - invalid, dir);
+  }
+
+  free(s.files);
+  return ret;
+}
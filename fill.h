@@ -0,0 +1,56 @@
+/*
+ * FFSMark
+ * Pierre Olivier <pierre.olivier@univ-brest.fr>
+ *
+ * Copyright (c) of University of Occidental Britanny (UBO) <pierre.olivier@univ-brest.fr>, 2015.
+ *
+ *	This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ * NO WARRANTY. THIS SOFTWARE IS FURNISHED ON AN "AS IS" BASIS.
+ * UNIVERSITY OF OCCIDENTAL BRITANNY MAKES NO WARRANTIES OF ANY KIND, EITHER
+ * EXPRESSED OR IMPLIED AS TO THE MATTER INCLUDING, BUT NOT LIMITED
+ * TO: WARRANTY OF FITNESS FOR PURPOSE OR MERCHANTABILITY, EXCLUSIVITY
+ * OF RESULTS OR RESULTS OBTAINED FROM USE OF THIS SOFTWARE. 
+ * See the GNU General Public License for more details.
+ *
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef FILL_H
+#define FILL_H
+
+#include <stdint.h>
+
+#include "distrib.h"
+
+/**
+ * Space filler: a file of 'size' bytes of binary pseudo-random data is
+ * written in FILL_BLOCK stripes by 'threads' writer threads with pwrite(),
+ * optionally preallocated with fallocate(), then synced so that the data
+ * reaches the flash before the file is kept or deleted. Progress and the
+ * fill throughput are printed to stdout.
+ */
+#define FILL_BLOCK  (1024 * 1024)
+
+int fill_file(char *path, uint64_t size, int threads, int preallocate);
+
+/**
+ * Fragmented fill: the space is written as many small files in directory
+ * 'dir', sizes drawn in [low, high] from 'sizes' (built by the caller for
+ * these bounds), valid and invalid
+ * files interleaved by runs of 'valid_run' and 'invalid_run' files (drawn
+ * at random when both are 0). The invalid files are then deleted, leaving
+ * stale pages scattered among the valid ones.
+ */
+int fill_fragmented(char *dir, uint64_t valid_size, uint64_t invalid_size,
+  size_distrib *sizes, int low, int high, int valid_run, int invalid_run,
+  int threads);
+int fill_size(size_distrib *sizes, int low, int high, distrib_stream *s);
+
+#endif /* FILL_H */
@@ -0,0 +1,230 @@
+/*
+ * FFSMark
+ * Pierre Olivier <pierre.olivier@univ-brest.fr>
+ *
+ * Copyright (c) of University of Occidental Britanny (UBO) <pierre.olivier@univ-brest.fr>, 2015.
+ *
+ *	This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ * NO WARRANTY. THIS SOFTWARE IS FURNISHED ON AN "AS IS" BASIS.
+ * UNIVERSITY OF OCCIDENTAL BRITANNY MAKES NO WARRANTIES OF ANY KIND, EITHER
+ * EXPRESSED OR IMPLIED AS TO THE MATTER INCLUDING, BUT NOT LIMITED
+ * TO: WARRANTY OF FITNESS FOR PURPOSE OR MERCHANTABILITY, EXCLUSIVITY
+ * OF RESULTS OR RESULTS OBTAINED FROM USE OF THIS SOFTWARE. 
+ * See the GNU General Public License for more details.
+ *
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "interval.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <errno.h>
+#include <pthread.h>
+
+#define MEGABYTE  (1024.0*1024.0)
+
+typedef struct
+{
+  volatile int enabled;
+  int stop;
+  uint64_t period_ns;
+  uint64_t start;             /* start of the sampling, latency_now() */
+  uint64_t last;              /* end of the last written interval */
+  FILE *fp;
+  pthread_t thread;
+  pthread_mutex_t lock;
+  pthread_cond_t cond;
+
+  /* shared accumulators, updated atomically */
+  uint64_t ops[LAT_OP_NUM];
+  uint64_t bytes_read;
+  uint64_t bytes_written;
+  latency_hist hist;
+} interval_state;
+
+static interval_state is = {.lock = PTHREAD_MUTEX_INITIALIZER,
+  .cond = PTHREAD_COND_INITIALIZER};
+
+static void *interval_sampler(void *arg);
+static void interval_flush(uint64_t now);
+
+int interval_start(char *path, int period_ms)
+{
+  pthread_condattr_t attr;
+  int i;
+
+  is.fp = fopen(path, "a");
+  if(is.fp == NULL)
+  {
+    fprintf(stderr, "Error: cannot open interval output '%s'\n", path);
+    return -1;
+  }
+
+  /* header once per file */
+  if(ftell(is.fp) == 0)
+  {
+    fprintf(is.fp, "time_s,ops_per_s");
+    for(i = 0; i < LAT_OP_NUM; i++)
+      fprintf(is.fp, ",%s_per_s", latency_op_name(i));
+    fprintf(is.fp, ",read_mb_per_s,write_mb_per_s,p50_us,p90_us,p99_us,"
+      "p999_us,max_us\n");
+  }
+
+  memset(is.ops, 0, sizeof(is.ops));
+  is.bytes_read = is.bytes_written = 0;
+  latency_hist_reset(&is.hist);
+
+  pthread_condattr_init(&attr);
+  pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+  pthread_cond_init(&is.cond, &attr);
+  pthread_condattr_destroy(&attr);
+
+  is.period_ns = (uint64_t)period_ms * 1000000ULL;
+  is.stop = 0;
+  is.start = is.last = latency_now();
+  is.enabled = 1;
+
+  if(pthread_create(&is.thread, NULL, interval_sampler, NULL))
+  {
+    fprintf(stderr, "Error: cannot start interval sampler\n");
+    is.enabled = 0;
+    fclose(is.fp);
+    return -1;
+  }
+
+  return 0;
+}
+
+void interval_stop()
+{
+  if(!is.enabled)
+    return;
+
+  pthread_mutex_lock(&is.lock);
+  is.stop = 1;
+  pthread_cond_signal(&is.cond);
+  pthread_mutex_unlock(&is.lock);
+  pthread_join(is.thread, NULL);
+
+  /* last, partial, interval */
+  interval_flush(latency_now());
+  is.enabled = 0;
+
+  fclose(is.fp);
+  pthread_cond_destroy(&is.cond);
+}
+
+void interval_record(latency_op op, uint64_t ns)
+{
+  uint64_t max;
+  int idx;
+
+  if(!is.enabled)
+    return;
+
+  __atomic_fetch_add(&is.ops[op], 1, __ATOMIC_RELAXED);
+
+  /* percentiles are those of the I/O operations */
+  if(op == LAT_TRANSACTION)
+    return;
+
+  idx = latency_hist_bucket(ns);
+  __atomic_fetch_add(&is.hist.buckets[idx], 1, __ATOMIC_RELAXED);
+
+  max = __atomic_load_n(&is.hist.max, __ATOMIC_RELAXED);
+  while(ns > max && !__atomic_compare_exchange_n(&is.hist.max, &max, ns, 0,
+    __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+    ;
+}
+
+void interval_add_bytes(uint64_t read, uint64_t written)
+{
+  if(!is.enabled)
+    return;
+
+  if(read)
+    __atomic_fetch_add(&is.bytes_read, read, __ATOMIC_RELAXED);
+  if(written)
+    __atomic_fetch_add(&is.bytes_written, written, __ATOMIC_RELAXED);
+}
+
+static void *interval_sampler(void *arg)
+{
+  struct timespec ts;
+  uint64_t next = is.start;
+
+  (void) arg;
+  pthread_mutex_lock(&is.lock);
+  while(!is.stop)
+  {
+    next += is.period_ns;
+    ts.tv_sec = next / 1000000000ULL;
+    ts.tv_nsec = next % 1000000000ULL;
+
+    while(!is.stop && 
+      pthread_cond_timedwait(&is.cond, &is.lock, &ts) != ETIMEDOUT)
+      ;
+
+    if(!is.stop)
+      interval_flush(latency_now());
+  }
+  pthread_mutex_unlock(&is.lock);
+
+  return NULL;
+}
+
+/**
+ * Drain the accumulators and write the row for [is.last, now]
+ */
+static void interval_flush(uint64_t now)
+{
+  latency_hist h;
+  uint64_t ops[LAT_OP_NUM], total = 0, bread, bwritten;
+  double secs;
+  int i;
+
+  latency_hist_reset(&h);
+  for(i = 0; i < LATENCY_BUCKETS; i++)
+  {
+    h.buckets[i] = __atomic_exchange_n(&is.hist.buckets[i], 0, 
+      __ATOMIC_RELAXED);
+    h.count += h.buckets[i];
+  }
+  h.max = __atomic_exchange_n(&is.hist.max, 0, __ATOMIC_RELAXED);
+
+  for(i = 0; i < LAT_OP_NUM; i++)
+  {
+    ops[i] = __atomic_exchange_n(&is.ops[i], 0, __ATOMIC_RELAXED);
+    if(i != LAT_TRANSACTION)
+      total += ops[i];
+  }
+  bread = __atomic_exchange_n(&is.bytes_read, 0, __ATOMIC_RELAXED);
+  bwritten = __atomic_exchange_n(&is.bytes_written, 0, __ATOMIC_RELAXED);
+
+  secs = (now - is.last) / 1000000000.0;
+  if(secs <= 0.0)
+    return;
+
+  fprintf(is.fp, "%.3lf,%.2lf", (now - is.start) / 1000000000.0, 
+    total / secs);
+  for(i = 0; i < LAT_OP_NUM; i++)
+    fprintf(is.fp, ",%.2lf", ops[i] / secs);
+  fprintf(is.fp, ",%.3lf,%.3lf,%.1lf,%.1lf,%.1lf,%.1lf,%.1lf\n",
+    bread / MEGABYTE / secs, bwritten / MEGABYTE / secs,
+    latency_hist_percentile(&h, 50.0) / 1000.0,
+    latency_hist_percentile(&h, 90.0) / 1000.0,
+    latency_hist_percentile(&h, 99.0) / 1000.0,
+    latency_hist_percentile(&h, 99.9) / 1000.0,
+    h.max / 1000.0);
+  fflush(is.fp);
+
+  is.last = now;
+}
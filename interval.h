@@ -0,0 +1,42 @@
+/*
+ * FFSMark
+ * Pierre Olivier <pierre.olivier@univ-brest.fr>
+ *
+ * Copyright (c) of University of Occidental Britanny (UBO) <pierre.olivier@univ-brest.fr>, 2015.
+ *
+ *	This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ * NO WARRANTY. THIS SOFTWARE IS FURNISHED ON AN "AS IS" BASIS.
+ * UNIVERSITY OF OCCIDENTAL BRITANNY MAKES NO WARRANTIES OF ANY KIND, EITHER
+ * EXPRESSED OR IMPLIED AS TO THE MATTER INCLUDING, BUT NOT LIMITED
+ * TO: WARRANTY OF FITNESS FOR PURPOSE OR MERCHANTABILITY, EXCLUSIVITY
+ * OF RESULTS OR RESULTS OBTAINED FROM USE OF THIS SOFTWARE. 
+ * See the GNU General Public License for more details.
+ *
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef INTERVAL_H
+#define INTERVAL_H
+
+#include <stdint.h>
+
+#include "latency.h"
+
+/**
+ * Interval sampling of the transaction phase: operations are accumulated
+ * in shared counters by every thread, and a sampler thread writes one CSV
+ * row (throughput, bandwidth, latency percentiles) per interval.
+ */
+int interval_start(char *path, int period_ms);
+void interval_stop();
+void interval_record(latency_op op, uint64_t ns);
+void interval_add_bytes(uint64_t read, uint64_t written);
+
+#endif /* INTERVAL_H */
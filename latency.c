@@ -0,0 +1,337 @@
+/*
+ * FFSMark
+ * Pierre Olivier <pierre.olivier@univ-brest.fr>
+ *
+ * Copyright (c) of University of Occidental Britanny (UBO) <pierre.olivier@univ-brest.fr>, 2015.
+ *
+ *	This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ * NO WARRANTY. THIS SOFTWARE IS FURNISHED ON AN "AS IS" BASIS.
+ * UNIVERSITY OF OCCIDENTAL BRITANNY MAKES NO WARRANTIES OF ANY KIND, EITHER
+ * EXPRESSED OR IMPLIED AS TO THE MATTER INCLUDING, BUT NOT LIMITED
+ * TO: WARRANTY OF FITNESS FOR PURPOSE OR MERCHANTABILITY, EXCLUSIVITY
+ * OF RESULTS OR RESULTS OBTAINED FROM USE OF THIS SOFTWARE. 
+ * See the GNU General Public License for more details.
+ *
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "latency.h"
+#include "results.h"
+#include "report.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <math.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "interval.h"
+
+static const char *op_names[LAT_OP_NUM] = {"create", "read", "append",
+  "delete", "open", "close", "write", "sync", "rename", "move", "stat",
+  "readdir", "link", "symlink", "truncate", "setxattr", "getxattr",
+  "overwrite", "pread", "transaction"};
+static const char *phase_names[LAT_PHASE_NUM] = {"Creation", "Transactions",
+  "Deletion"};
+
+/* run totals, [phase][op] */
+static latency_hist totals[LAT_PHASE_NUM][LAT_OP_NUM];
+static pthread_mutex_t totals_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* per thread tables */
+static __thread latency_hist (*local)[LAT_OP_NUM] = NULL;
+static __thread latency_phase current_phase = LAT_PHASE_CREATION;
+
+static uint64_t bucket_value(int idx);
+
+uint64_t latency_now()
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+void latency_hist_reset(latency_hist *h)
+{
+  memset(h, 0, sizeof(latency_hist));
+}
+
+void latency_hist_add(latency_hist *h, uint64_t ns)
+{
+  if(h->count == 0 || ns < h->min)
+    h->min = ns;
+  if(ns > h->max)
+    h->max = ns;
+
+  h->count++;
+  h->sum += ns;
+  h->buckets[latency_hist_bucket(ns)]++;
+}
+
+void latency_hist_merge(latency_hist *dst, latency_hist *src)
+{
+  int i;
+
+  if(src->count == 0)
+    return;
+
+  if(dst->count == 0 || src->min < dst->min)
+    dst->min = src->min;
+  if(src->max > dst->max)
+    dst->max = src->max;
+
+  dst->count += src->count;
+  dst->sum += src->sum;
+  for(i = 0; i < LATENCY_BUCKETS; i++)
+    dst->buckets[i] += src->buckets[i];
+}
+
+/**
+ * Value at percentile p (0-100): upper bound of the bucket holding it,
+ * clamped to the exact maximum
+ */
+uint64_t latency_hist_percentile(latency_hist *h, double p)
+{
+  uint64_t rank, seen = 0, v;
+  int i;
+
+  if(h->count == 0)
+    return 0;
+
+  rank = (uint64_t)((p / 100.0) * (double)h->count + 0.5);
+  if(rank < 1)
+    rank = 1;
+
+  for(i = 0; i < LATENCY_BUCKETS; i++)
+  {
+    seen += h->buckets[i];
+    if(seen >= rank)
+    {
+      v = bucket_value(i + 1) - 1;
+      return (v > h->max) ? h->max : v;
+    }
+  }
+
+  return h->max;
+}
+
+int latency_thread_init()
+{
+  if(local)
+    return 0;
+
+  local = calloc(LAT_PHASE_NUM, sizeof(*local));
+  if(local == NULL)
+  {
+    perror("calloc");
+    return -1;
+  }
+
+  current_phase = LAT_PHASE_CREATION;
+  return 0;
+}
+
+void latency_set_phase(latency_phase phase)
+{
+  current_phase = phase;
+}
+
+/**
+ * Record an operation of type op started at 'start' (latency_now() value)
+ * and ending now
+ */
+void latency_record(latency_op op, uint64_t start)
+{
+  latency_record_ns(op, latency_now() - start);
+}
+
+void latency_record_ns(latency_op op, uint64_t ns)
+{
+  if(local)
+    latency_hist_add(&local[current_phase][op], ns);
+
+  interval_record(op, ns);
+}
+
+void latency_thread_merge()
+{
+  int i, j;
+
+  if(!local)
+    return;
+
+  pthread_mutex_lock(&totals_lock);
+  for(i = 0; i < LAT_PHASE_NUM; i++)
+    for(j = 0; j < LAT_OP_NUM; j++)
+      latency_hist_merge(&totals[i][j], &local[i][j]);
+  pthread_mutex_unlock(&totals_lock);
+
+  free(local);
+  local = NULL;
+}
+
+void latency_reset()
+{
+  int i, j;
+
+  for(i = 0; i < LAT_PHASE_NUM; i++)
+    for(j = 0; j < LAT_OP_NUM; j++)
+      latency_hist_reset(&totals[i][j]);
+}
+
+latency_hist *latency_get(latency_phase phase, latency_op op)
+{
+  return &totals[phase][op];
+}
+
+const char *latency_op_name(latency_op op)
+{
+  return op_names[op];
+}
+
+const char *latency_phase_name(latency_phase phase)
+{
+  return phase_names[phase];
+}
+
+void latency_report(FILE *fp)
+{
+  int i, j, width = 0;
+  latency_hist *h;
+
+  /* operation column as wide as the longest name */
+  for(j = 0; j < LAT_OP_NUM; j++)
+    if((int)strlen(op_names[j]) > width)
+      width = strlen(op_names[j]);
+
+  fprintf(fp, "\nLatency (microseconds):\n");
+  for(i = 0; i < LAT_PHASE_NUM; i++)
+  {
+    fprintf(fp, "\t%s phase:\n", phase_names[i]);
+    for(j = 0; j < LAT_OP_NUM; j++)
+    {
+      h = &totals[i][j];
+      if(h->count == 0)
+        continue;
+
+      fprintf(fp, "\t\t%-*s %8llu ops, mean %.1lf, p50 %.1lf, p90 %.1lf, "
+        "p99 %.1lf, p99.9 %.1lf, max %.1lf\n", width, op_names[j],
+        (unsigned long long)h->count, (double)h->sum / h->count / 1000.0,
+        latency_hist_percentile(h, 50.0) / 1000.0,
+        latency_hist_percentile(h, 90.0) / 1000.0,
+        latency_hist_percentile(h, 99.0) / 1000.0,
+        latency_hist_percentile(h, 99.9) / 1000.0,
+        h->max / 1000.0);
+    }
+  }
+}
+
+/**
+ * Transaction phase latencies of the iteration, for the run summary
+ */
+void latency_results()
+{
+  char name[RESULTS_NAME_LEN];
+  latency_hist *h;
+  int j;
+
+  for(j = 0; j < LAT_OP_NUM; j++)
+  {
+    h = &totals[LAT_PHASE_TRANSACTIONS][j];
+    if(h->count == 0)
+      continue;
+
+    snprintf(name, sizeof(name), "%s latency mean (us)", op_names[j]);
+    results_add(name, (double)h->sum / h->count / 1000.0);
+    snprintf(name, sizeof(name), "%s latency p50 (us)", op_names[j]);
+    results_add(name, latency_hist_percentile(h, 50.0) / 1000.0);
+    snprintf(name, sizeof(name), "%s latency p99 (us)", op_names[j]);
+    results_add(name, latency_hist_percentile(h, 99.0) / 1000.0);
+    snprintf(name, sizeof(name), "%s latency p99.9 (us)", op_names[j]);
+    results_add(name, latency_hist_percentile(h, 99.9) / 1000.0);
+  }
+}
+
+static void latency_field(const char *phase, latency_op op,
+  const char *name, latency_hist *h, double ns)
+{
+  char key[REPORT_KEY_LEN];
+
+  snprintf(key, sizeof(key), "latency.%s.%s.%s", phase, op_names[op], name);
+  report_number(key, h->count ? ns / 1000.0 : NAN);
+}
+
+/**
+ * Latencies of every phase and operation as report fields, under
+ * latency.<phase>.<op>; operations never seen have a zero count and null
+ * statistics, so that the CSV columns do not depend on the run
+ */
+void latency_report_fields()
+{
+  char key[REPORT_KEY_LEN], phase[32];
+  latency_hist *h;
+  int i, j, k;
+
+  for(i = 0; i < LAT_PHASE_NUM; i++)
+  {
+    for(k = 0; phase_names[i][k] && k < (int)sizeof(phase) - 1; k++)
+      phase[k] = tolower(phase_names[i][k]);
+    phase[k] = '\0';
+
+    for(j = 0; j < LAT_OP_NUM; j++)
+    {
+      h = &totals[i][j];
+      snprintf(key, sizeof(key), "latency.%s.%s.count", phase, op_names[j]);
+      report_integer(key, h->count);
+      latency_field(phase, j, "mean_us", h,
+        h->count ? (double)h->sum / h->count : 0);
+      latency_field(phase, j, "p50_us", h, latency_hist_percentile(h, 50.0));
+      latency_field(phase, j, "p90_us", h, latency_hist_percentile(h, 90.0));
+      latency_field(phase, j, "p99_us", h, latency_hist_percentile(h, 99.0));
+      latency_field(phase, j, "p99_9_us", h,
+        latency_hist_percentile(h, 99.9));
+      latency_field(phase, j, "max_us", h, h->max);
+    }
+  }
+}
+
+/**
+ * Values below 2^LATENCY_SUB_BITS have their own bucket, above each power
+ * of two is cut in 2^LATENCY_SUB_BITS sub-buckets
+ */
+int latency_hist_bucket(uint64_t v)
+{
+  int e, shift, idx;
+
+  if(v < (1ULL << LATENCY_SUB_BITS))
+    return (int)v;
+
+  e = 63 - __builtin_clzll(v);
+  shift = e - LATENCY_SUB_BITS;
+  idx = ((shift + 1) << LATENCY_SUB_BITS) +
+    (int)((v >> shift) - (1ULL << LATENCY_SUB_BITS));
+
+  return (idx < LATENCY_BUCKETS) ? idx : LATENCY_BUCKETS - 1;
+}
+
+/* lowest value falling in bucket idx */
+static uint64_t bucket_value(int idx)
+{
+  int shift;
+
+  if(idx < (1 << LATENCY_SUB_BITS))
+    return (uint64_t)idx;
+
+  shift = (idx >> LATENCY_SUB_BITS) - 1;
+  return ((uint64_t)((idx & ((1 << LATENCY_SUB_BITS) - 1)) +
+    (1 << LATENCY_SUB_BITS))) << shift;
+}
@@ -0,0 +1,109 @@
+/*
+ * FFSMark
+ * Pierre Olivier <pierre.olivier@univ-brest.fr>
+ *
+ * Copyright (c) of University of Occidental Britanny (UBO) <pierre.olivier@univ-brest.fr>, 2015.
+ *
+ *	This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ * NO WARRANTY. THIS SOFTWARE IS FURNISHED ON AN "AS IS" BASIS.
+ * UNIVERSITY OF OCCIDENTAL BRITANNY MAKES NO WARRANTIES OF ANY KIND, EITHER
+ * EXPRESSED OR IMPLIED AS TO THE MATTER INCLUDING, BUT NOT LIMITED
+ * TO: WARRANTY OF FITNESS FOR PURPOSE OR MERCHANTABILITY, EXCLUSIVITY
+ * OF RESULTS OR RESULTS OBTAINED FROM USE OF THIS SOFTWARE. 
+ * See the GNU General Public License for more details.
+ *
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef LATENCY_H
+#define LATENCY_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+/**
+ * Log-bucketed (HDR style) latency histograms: each power of two is split
+ * in 2^LATENCY_SUB_BITS linear sub-buckets, giving a relative precision
+ * of about 3% from 1 ns up to 2^LATENCY_MAX_BITS ns.
+ */
+#define LATENCY_SUB_BITS    5
+#define LATENCY_MAX_BITS    42
+#define LATENCY_BUCKETS     ((LATENCY_MAX_BITS - LATENCY_SUB_BITS + 1) << \
+                              LATENCY_SUB_BITS)
+
+typedef struct
+{
+  uint64_t count;
+  uint64_t sum;
+  uint64_t min;
+  uint64_t max;
+  uint64_t buckets[LATENCY_BUCKETS];
+} latency_hist;
+
+typedef enum
+{
+  LAT_CREATE = 0,
+  LAT_READ,
+  LAT_APPEND,
+  LAT_DELETE,
+  LAT_OPEN,
+  LAT_CLOSE,
+  LAT_WRITE,
+  LAT_SYNC,
+  LAT_RENAME,
+  LAT_MOVE,                   /* rename to another directory */
+  LAT_STAT,
+  LAT_READDIR,
+  LAT_LINK,
+  LAT_SYMLINK,
+  LAT_TRUNCATE,
+  LAT_SETXATTR,
+  LAT_GETXATTR,
+  LAT_OVERWRITE,              /* in place write at an offset */
+  LAT_PREAD,                  /* partial read at an offset */
+  LAT_TRANSACTION,            /* whole transaction, not an I/O operation */
+  LAT_OP_NUM
+} latency_op;
+
+typedef enum
+{
+  LAT_PHASE_CREATION = 0,
+  LAT_PHASE_TRANSACTIONS,
+  LAT_PHASE_DELETION,
+  LAT_PHASE_NUM
+} latency_phase;
+
+uint64_t latency_now();
+
+void latency_hist_reset(latency_hist *h);
+void latency_hist_add(latency_hist *h, uint64_t ns);
+void latency_hist_merge(latency_hist *dst, latency_hist *src);
+int latency_hist_bucket(uint64_t ns);
+uint64_t latency_hist_percentile(latency_hist *h, double p);
+
+/**
+ * Per thread recording: each thread records in its own tables, merged in
+ * the run totals by latency_thread_merge()
+ */
+int latency_thread_init();
+void latency_set_phase(latency_phase phase);
+void latency_record(latency_op op, uint64_t start);
+void latency_record_ns(latency_op op, uint64_t ns);
+void latency_thread_merge();
+
+void latency_reset();
+latency_hist *latency_get(latency_phase phase, latency_op op);
+const char *latency_op_name(latency_op op);
+const char *latency_phase_name(latency_phase phase);
+void latency_report(FILE *fp);
+void latency_results();
+void latency_report_fields();
+
+#endif /* LATENCY_H */
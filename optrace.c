@@ -0,0 +1,338 @@
+/*
+ * FFSMark
+ * Pierre Olivier <pierre.olivier@univ-brest.fr>
+ *
+ * Copyright (c) of University of Occidental Britanny (UBO) <pierre.olivier@univ-brest.fr>, 2015.
+ *
+ *	This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ * NO WARRANTY. THIS SOFTWARE IS FURNISHED ON AN "AS IS" BASIS.
+ * UNIVERSITY OF OCCIDENTAL BRITANNY MAKES NO WARRANTIES OF ANY KIND, EITHER
+ * EXPRESSED OR IMPLIED AS TO THE MATTER INCLUDING, BUT NOT LIMITED
+ * TO: WARRANTY OF FITNESS FOR PURPOSE OR MERCHANTABILITY, EXCLUSIVITY
+ * OF RESULTS OR RESULTS OBTAINED FROM USE OF THIS SOFTWARE. 
+ * See the GNU General Public License for more details.
+ *
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "optrace.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sched.h>
+#include <pthread.h>
+
+#define RING_SIZE         65536     /* records per thread, power of 2 */
+#define FLUSH_PERIOD_NS   1000000
+
+typedef struct ring_struct
+{
+  optrace_record rec[RING_SIZE];
+  uint64_t head;              /* written by the producer thread */
+  uint64_t tail;              /* written by the flusher */
+  struct ring_struct *next;
+} ring;
+
+static const char *op_names[OPTRACE_OP_NUM] = {"create", "read", "append",
+  "delete", "open", "close", "write", "fsync", "rename", "truncate"};
+
+static FILE *out = NULL;
+static char *out_path = NULL;
+static volatile int recording = 0;
+static int stop_flusher;
+static pthread_t flusher;
+static pthread_mutex_t rings_lock = PTHREAD_MUTEX_INITIALIZER;
+static ring *rings = NULL;
+static uint64_t stalls;
+
+/* ring of the calling thread and the recording it belongs to */
+static __thread ring *local = NULL;
+static __thread int local_gen = 0;
+static int generation = 0;
+
+extern __thread int worker;
+
+static void *optrace_flusher(void *arg);
+static int optrace_drain();
+static ring *optrace_ring();
+static void optrace_sort();
+
+int optrace_start(char *path)
+{
+  optrace_header h;
+  struct timespec mono, real;
+
+  out = fopen(path, "w");
+  if(out == NULL)
+  {
+    fprintf(stderr, "Error: cannot open trace file '%s'\n", path);
+    return -1;
+  }
+  free(out_path);
+  out_path = strdup(path);
+
+  clock_gettime(CLOCK_MONOTONIC, &mono);
+  clock_gettime(CLOCK_REALTIME, &real);
+
+  memset(&h, 0, sizeof(h));
+  memcpy(h.magic, OPTRACE_MAGIC, sizeof(h.magic));
+  h.version = OPTRACE_VERSION;
+  h.record_size = sizeof(optrace_record);
+  h.monotonic_base = (uint64_t)mono.tv_sec * 1000000000ULL + mono.tv_nsec;
+  h.realtime_base = (uint64_t)real.tv_sec * 1000000000ULL + real.tv_nsec;
+  fwrite(&h, sizeof(h), 1, out);
+
+  stalls = 0;
+  stop_flusher = 0;
+  generation++;
+  recording = 1;
+
+  if(pthread_create(&flusher, NULL, optrace_flusher, NULL))
+  {
+    fprintf(stderr, "Error: cannot start trace flusher\n");
+    recording = 0;
+    fclose(out);
+    return -1;
+  }
+
+  return 0;
+}
+
+void optrace_stop()
+{
+  ring *r;
+
+  if(!recording)
+    return;
+
+  recording = 0;
+  __atomic_store_n(&stop_flusher, 1, __ATOMIC_RELEASE);
+  pthread_join(flusher, NULL);
+  optrace_drain();
+
+  if(stalls)
+    fprintf(stderr, "Warning: trace buffers were full %llu times\n",
+      (unsigned long long)stalls);
+
+  fclose(out);
+  out = NULL;
+  optrace_sort();
+
+  pthread_mutex_lock(&rings_lock);
+  while(rings)
+  {
+    r = rings->next;
+    free(rings);
+    rings = r;
+  }
+  pthread_mutex_unlock(&rings_lock);
+}
+
+/**
+ * Append one record to the calling thread's ring, waiting for the flusher
+ * if it is full
+ */
+void optrace_add(optrace_op op, uint32_t file_id, uint64_t offset,
+  uint32_t size, uint32_t aux, uint64_t start, uint64_t end, int result)
+{
+  optrace_record *rec;
+  ring *r;
+
+  if(!recording || (r = optrace_ring()) == NULL)
+    return;
+
+  if(r->head - __atomic_load_n(&r->tail, __ATOMIC_ACQUIRE) == RING_SIZE)
+  {
+    __sync_fetch_and_add(&stalls, 1);
+    while(r->head - __atomic_load_n(&r->tail, __ATOMIC_ACQUIRE) == RING_SIZE)
+      sched_yield();
+  }
+
+  rec = &r->rec[r->head & (RING_SIZE - 1)];
+  rec->start = start;
+  rec->end = end;
+  rec->offset = offset;
+  rec->file_id = file_id;
+  rec->size = size;
+  rec->aux = aux;
+  rec->result = result;
+  rec->op = op;
+  rec->thread = worker + 1;
+
+  __atomic_store_n(&r->head, r->head + 1, __ATOMIC_RELEASE);
+}
+
+int optrace_reader_open(optrace_reader *r, char *path)
+{
+  r->fp = fopen(path, "r");
+  if(r->fp == NULL)
+  {
+    fprintf(stderr, "Error: cannot open trace file '%s'\n", path);
+    return -1;
+  }
+
+  if(fread(&r->header, sizeof(r->header), 1, r->fp) != 1
+    || memcmp(r->header.magic, OPTRACE_MAGIC, sizeof(r->header.magic))
+    || r->header.version != OPTRACE_VERSION
+    || r->header.record_size < sizeof(optrace_record))
+  {
+    fprintf(stderr, "Error: '%s' is not a FFSMark trace\n", path);
+    fclose(r->fp);
+    r->fp = NULL;
+    return -1;
+  }
+
+  return 0;
+}
+
+/**
+ * Read the next record, return 1 on success, 0 at the end of the trace and
+ * -1 on a truncated record. Bytes beyond the known fields of a record are
+ * skipped.
+ */
+int optrace_reader_next(optrace_reader *r, optrace_record *rec)
+{
+  size_t got = fread(rec, 1, sizeof(optrace_record), r->fp);
+
+  if(got != sizeof(optrace_record))
+    return got ? -1 : 0;
+
+  if(r->header.record_size > sizeof(optrace_record))
+    fseek(r->fp, r->header.record_size - sizeof(optrace_record), SEEK_CUR);
+
+  return 1;
+}
+
+void optrace_reader_close(optrace_reader *r)
+{
+  if(r->fp)
+    fclose(r->fp);
+  r->fp = NULL;
+}
+
+const char *optrace_op_name(int op)
+{
+  return (op >= 0 && op < OPTRACE_OP_NUM) ? op_names[op] : "unknown";
+}
+
+static ring *optrace_ring()
+{
+  if(local && local_gen == generation)
+    return local;
+
+  local = (ring *)calloc(1, sizeof(ring));
+  if(local == NULL)
+    return NULL;
+  local_gen = generation;
+
+  pthread_mutex_lock(&rings_lock);
+  local->next = rings;
+  rings = local;
+  pthread_mutex_unlock(&rings_lock);
+
+  return local;
+}
+
+static void *optrace_flusher(void *arg)
+{
+  struct timespec ts = {0, FLUSH_PERIOD_NS};
+
+  (void) arg;
+  while(!__atomic_load_n(&stop_flusher, __ATOMIC_ACQUIRE))
+    if(optrace_drain() == 0)
+      nanosleep(&ts, NULL);
+
+  return NULL;
+}
+
+/**
+ * Write every record available in the rings, return how many were written
+ */
+static int optrace_drain()
+{
+  ring *r;
+  uint64_t head, tail, n;
+  int total = 0;
+
+  pthread_mutex_lock(&rings_lock);
+  for(r = rings; r; r = r->next)
+  {
+    head = __atomic_load_n(&r->head, __ATOMIC_ACQUIRE);
+    tail = r->tail;
+
+    while(tail != head)
+    {
+      /* contiguous chunk up to the end of the ring */
+      n = RING_SIZE - (tail & (RING_SIZE - 1));
+      if(n > head - tail)
+        n = head - tail;
+
+      fwrite(&r->rec[tail & (RING_SIZE - 1)], sizeof(optrace_record), n, 
+        out);
+      tail += n;
+      total += n;
+    }
+
+    __atomic_store_n(&r->tail, tail, __ATOMIC_RELEASE);
+  }
+  pthread_mutex_unlock(&rings_lock);
+
+  return total;
+}
+
+static int optrace_compare(const void *a, const void *b)
+{
+  const optrace_record *x = a, *y = b;
+
+  if(x->start != y->start)
+    return (x->start < y->start) ? -1 : 1;
+  if(x->thread != y->thread)
+    return (x->thread < y->thread) ? -1 : 1;
+  return (x->end < y->end) ? -1 : (x->end > y->end);
+}
+
+/**
+ * The rings are drained one after the other, so the records of different
+ * threads are interleaved by chunks: once recorded, the trace is rewritten
+ * in start time order. Each thread's records already are in that order.
+ */
+static void optrace_sort()
+{
+  optrace_record *recs;
+  FILE *fp;
+  long size;
+  size_t n;
+
+  if(out_path == NULL || (fp = fopen(out_path, "r+")) == NULL)
+    return;
+
+  fseek(fp, 0, SEEK_END);
+  size = ftell(fp);
+  n = (size > (long)sizeof(optrace_header)) ?
+    (size - sizeof(optrace_header)) / sizeof(optrace_record) : 0;
+  recs = (optrace_record *)malloc(n * sizeof(optrace_record));
+
+  if(n && recs == NULL)
+    fprintf(stderr, "Warning: trace '%s' left in drain order\n", out_path);
+  else if(n)
+  {
+    fseek(fp, sizeof(optrace_header), SEEK_SET);
+    if(fread(recs, sizeof(optrace_record), n, fp) == n)
+    {
+      qsort(recs, n, sizeof(optrace_record), optrace_compare);
+      fseek(fp, sizeof(optrace_header), SEEK_SET);
+      fwrite(recs, sizeof(optrace_record), n, fp);
+    }
+  }
+
+  free(recs);
+  fclose(fp);
+}
@@ -0,0 +1,115 @@
+/*
+ * FFSMark
+ * Pierre Olivier <pierre.olivier@univ-brest.fr>
+ *
+ * Copyright (c) of University of Occidental Britanny (UBO) <pierre.olivier@univ-brest.fr>, 2015.
+ *
+ *	This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ * NO WARRANTY. THIS SOFTWARE IS FURNISHED ON AN "AS IS" BASIS.
+ * UNIVERSITY OF OCCIDENTAL BRITANNY MAKES NO WARRANTIES OF ANY KIND, EITHER
+ * EXPRESSED OR IMPLIED AS TO THE MATTER INCLUDING, BUT NOT LIMITED
+ * TO: WARRANTY OF FITNESS FOR PURPOSE OR MERCHANTABILITY, EXCLUSIVITY
+ * OF RESULTS OR RESULTS OBTAINED FROM USE OF THIS SOFTWARE. 
+ * See the GNU General Public License for more details.
+ *
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef OPTRACE_H
+#define OPTRACE_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+/**
+ * Binary operation trace format: an optrace_header followed by
+ * fixed-size optrace_record entries, little endian (host order).
+ * Timestamps are CLOCK_MONOTONIC nanoseconds; the header holds a
+ * monotonic/realtime pair taken at the same instant so that records can
+ * be matched with Flashmon's log, which is timestamped with the wall
+ * clock.
+ */
+#define OPTRACE_MAGIC     "FFSMTRC1"
+#define OPTRACE_VERSION   1
+
+typedef enum
+{
+  OPTRACE_CREATE = 0,         /* create file_id, write size bytes */
+  OPTRACE_READ,               /* read size bytes at offset */
+  OPTRACE_APPEND,             /* append size bytes, file was offset bytes */
+  OPTRACE_DELETE,             /* delete file_id */
+  OPTRACE_OPEN,               /* open file_id, aux holds OPTRACE_OPEN_* */
+  OPTRACE_CLOSE,              /* close file_id */
+  OPTRACE_WRITE,              /* write size bytes at offset */
+  OPTRACE_FSYNC,              /* fsync file_id, aux holds OPTRACE_FSYNC_* */
+  OPTRACE_RENAME,             /* rename file_id over file aux */
+  OPTRACE_TRUNCATE,           /* truncate file_id to offset bytes */
+  OPTRACE_OP_NUM
+} optrace_op;
+
+/* aux of OPTRACE_CREATE: the file existed before the trace started */
+#define OPTRACE_CREATE_PRELOAD  1
+
+/* aux of OPTRACE_FSYNC: fdatasync, or syncfs of the file's file system */
+#define OPTRACE_FSYNC_DATA      1
+#define OPTRACE_FSYNC_FS        2
+
+/* aux of OPTRACE_OPEN */
+#define OPTRACE_OPEN_CREATE     1
+#define OPTRACE_OPEN_TRUNCATE   2
+
+typedef struct
+{
+  char magic[8];
+  uint32_t version;
+  uint32_t record_size;
+  uint64_t monotonic_base;    /* CLOCK_MONOTONIC ns ... */
+  uint64_t realtime_base;     /* ... and CLOCK_REALTIME ns, same instant */
+} __attribute__((packed)) optrace_header;
+
+typedef struct
+{
+  uint64_t start;             /* ns */
+  uint64_t end;               /* ns */
+  uint64_t offset;
+  uint32_t file_id;
+  uint32_t size;
+  uint32_t aux;               /* operation specific, 0 if unused */
+  int16_t result;             /* 0 or -errno */
+  uint8_t op;                 /* optrace_op */
+  uint8_t thread;             /* 0 for the main thread, worker id + 1 */
+} __attribute__((packed)) optrace_record;
+
+/**
+ * Recording: each thread appends to its own ring buffer, drained to the
+ * file by a background thread. optrace_stop() sorts the records by start
+ * time.
+ */
+int optrace_start(char *path);
+void optrace_stop();
+void optrace_add(optrace_op op, uint32_t file_id, uint64_t offset,
+  uint32_t size, uint32_t aux, uint64_t start, uint64_t end, int result);
+
+/**
+ * Replay: sequential reader of a trace file
+ */
+typedef struct
+{
+  FILE *fp;
+  optrace_header header;
+} optrace_reader;
+
+int optrace_reader_open(optrace_reader *r, char *path);
+int optrace_reader_next(optrace_reader *r, optrace_record *rec);
+void optrace_reader_close(optrace_reader *r);
+
+const char *optrace_op_name(int op);
+
+#endif /* OPTRACE_H */
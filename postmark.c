@@ -184,11 +184,16 @@ Versions:
       Also changed MB definition to 1024KB, tweaked show command
 */
 
+#define _GNU_SOURCE		/* FFSMark: O_DIRECT */
+
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
 #include <time.h>
 #include <fcntl.h>
+#include <errno.h>
+#include <stdint.h>
+#include <math.h>
 
 #ifdef _WIN32
 /* FFSMark */
@@ -205,7 +210,18 @@ Versions:
 #include <sys/time.h>
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <pthread.h>
+#include <dirent.h>
+#include <sys/xattr.h>
 #include "ffsmark_core.h"
+#include "uring_engine.h"
+#include "latency.h"
+#include "interval.h"
+#include "distrib.h"
+#include "optrace.h"
+#include "datagen.h"
+#include "results.h"
+#include "report.h"
 
 extern char *getwd ();
 
@@ -245,6 +261,31 @@ extern int cli_set_report ();
 extern int cli_set_flashmon();
 extern int cli_set_direct();
 extern int cli_set_sync();
+extern int cli_set_threads ();
+extern int cli_set_engine ();
+extern int cli_set_queue_depth ();
+extern int cli_set_interval ();
+extern int cli_set_rate ();
+extern int cli_set_popularity ();
+extern int cli_set_distribution_create ();
+extern int cli_set_distribution_append ();
+extern int cli_set_replay ();
+extern int cli_set_pregenerate ();
+extern int cli_set_source ();
+extern int cli_set_compressibility ();
+extern int cli_set_content ();
+extern int cli_set_dedupe ();
+extern int cli_set_repeat ();
+extern int cli_set_warmup ();
+extern int cli_set_fsync ();
+extern int cli_set_mix ();
+extern int cli_set_overwrite ();
+extern int cli_set_pread ();
+extern int cli_sweep_add ();
+extern int cli_sweep_clear ();
+extern int cli_sweep_order ();
+extern int cli_sweep_results ();
+extern int cli_sweep_run ();
 
 extern int cli_run ();
 extern int cli_show ();
@@ -265,14 +306,40 @@ cmd command_list[] = {		/* table of CLI commands */
    "Sets the chance of choosing read over append"},
   {"set bias create", cli_set_bias_create,
    "Sets the chance of choosing create over delete"},
-  {"set report", cli_set_report, "Choose verbose or terse report format"},
+  {"set mix", cli_set_mix, "[operation weight ... | off] Weighted mix replacing the read/append half of the transactions: read, append, overwrite, pread (partial read), rename, move (to another subdirectory), stat, readdir, link, symlink, truncate, setxattr, getxattr"},
+  {"set overwrite", cli_set_overwrite, "[bytes [alignment]] Size of the in-place writes of the mix, at random offsets multiple of alignment (1 for unaligned), rounded up to the direct I/O alignment"},
+  {"set pread", cli_set_pread, "[bytes [alignment]] Size of the partial reads of the mix, at random offsets multiple of alignment (1 for unaligned), rounded up to the direct I/O alignment"},
+  {"set report", cli_set_report, "[verbose | terse | json | csv] [file] Choose the report format, json and csv reports being appended to file when given"},
   {"run", cli_run, "Runs one iteration of benchmark"},
+  {"sweep add", cli_sweep_add, "[set command : value | value | from..to+step | from..to*factor ...] Adds a swept parameter, e.g. 'sweep add set read : 512..65536*2'"},
+  {"sweep clear", cli_sweep_clear, "Removes all swept parameters"},
+  {"sweep order", cli_sweep_order, "[sequential | random] Order of the sweep points (random avoids drift bias)"},
+  {"sweep results", cli_sweep_results, "[file] CSV file receiving one row per sweep point (appended)"},
+  {"sweep run", cli_sweep_run, "[file] Runs the cartesian product of the swept parameters, each point as 'run'; the swept settings are not restored and stay at the last point"},
   {"show", cli_show, "Displays current configuration"},
   {"help", cli_help, "Prints out available commands"},
   {"quit", cli_quit, "Exit program"},
   /* FFSMark */
   {"set direct", cli_set_direct, "[true | false] Use direct I/O (only when buffered is false)"},
   {"set sync", cli_set_sync, "[true | false] Use synchronous I/O (only when buffered is false)"}, 
+  {"set fsync", cli_set_fsync, "[none | write | close | every N | group N] [fsync | fdatasync] Sync after each write, before each close of a written file, with one syncfs of the file system on every Nth written file, or in batches of N written files (group commit)"},
+  {"set threads", cli_set_threads, "[number] Number of worker threads performing the transactions"},
+  {"set engine", cli_set_engine, "[sync | uring] I/O engine used when buffered is false"},
+  {"set queue depth", cli_set_queue_depth, "[number] Maximum number of SQEs per io_uring submission"},
+  {"set popularity", cli_set_popularity, "[uniform | zipf theta | hotset fraction probability] Distribution of the files targeted by read/append/delete"},
+  {"set distribution create", cli_set_distribution_create, "[uniform | lognormal mu sigma | pareto alpha xm | buckets size:weight ... | empirical file] Distribution of the initial file sizes, within the 'set size' bounds"},
+  {"set distribution append", cli_set_distribution_append, "[uniform | lognormal mu sigma | pareto alpha xm | buckets size:weight ... | empirical file] Distribution of the append sizes"},
+  {"set rate", cli_set_rate, "[tx/s [poisson] | 0] Open-loop mode: start transactions on a fixed (or Poisson) timeline, 0 for closed-loop"},
+  {"set record", cli_set_record, "[file | off] Record every file operation to a binary trace"},
+  {"set source", cli_set_source, "[printable | binary] Content of the data written to the files"},
+  {"set compressibility", cli_set_compressibility, "[ratio | off] Binary data compressing by about ratio:1 (4KiB chunks), each write from a different part of it"},
+  {"set content", cli_set_content, "[shared | unique] Every write copies the same buffer, or gets data derived from (file, offset, seed)"},
+  {"set dedupe", cli_set_dedupe, "[ratio] Fraction of the 4KiB blocks of unique content that duplicate one of a few shared blocks"},
+  {"set repeat", cli_set_repeat, "[number [reseed]] Measured iterations of 'run', summarized by mean, stddev, range and 95% confidence interval; reseed uses seed, seed + 1, ..."},
+  {"set warmup", cli_set_warmup, "[number] Unreported iterations of 'run' before the measured ones"},
+  {"set pregenerate", cli_set_pregenerate, "[true | false] Decide every transaction before the timed phase, which then only performs I/O"},
+  {"set replay", cli_set_replay, "[file [afap | timed] | off] Replay a binary operation trace instead of the transactions"},
+  {"set interval", cli_set_interval, "[ms file | 0] Write throughput and latency of each interval of the transaction phase to a CSV file"},
   {"set flashmon", cli_set_flashmon, "[true | false] Use flashmon to report flash statistics (module must be loaded)"},
   {"set drop creation", cli_set_drop_creation, "[true | false] Drop the system caches at the start of the benchmark (need root permissions)"},
   {"set drop transactions", cli_set_drop_transactions, "[true | false] Drop the system caches before the transaction phase (need root permissions)"},
@@ -280,6 +347,14 @@ cmd command_list[] = {		/* table of CLI commands */
   {"set fill creation invalid", cli_set_fill_invalid_creation, "[ratio] Percentage of free space transformed into invalid space at the start of the benchmark"},
   {"set fill transaction valid", cli_set_fill_valid_transaction, "[ratio] Percentage of free space transformed into valid space before the transaction phase"},
   {"set fill transaction invalid", cli_set_fill_invalid_transaction, "[ratio] Percentage of free space transformed into invalid space before the transaction phase"},
+  {"set fill threads", cli_set_fill_threads, "[number] Writer threads creating the valid/invalid space"},
+  {"set fill fallocate", cli_set_fill_fallocate, "[true | false] Preallocate the valid/invalid space files before writing them"},
+  {"set fill mode", cli_set_fill_mode, "[contiguous | fragmented] One big valid and one big invalid file, or many small interleaved ones"},
+  {"set fill files", cli_set_fill_files, "[low high [uniform | lognormal mu sigma | pareto alpha xm | buckets size:weight ... | empirical file]] Sizes of the fragmented fill files"},
+  {"set fill pattern", cli_set_fill_pattern, "[random | valid:invalid] Interleaving of the fragmented fill files: runs of valid then invalid files, or drawn at random"},
+  {"set aging written", cli_set_aging_written, "[MB | 0] Age the file system by a create/append/delete churn writing that much before the benchmark, in a directory removed after the run"},
+  {"set aging fragmentation", cli_set_aging_fragmentation, "[extents | 0] Age the file system until its files average that many extents (FIEMAP), giving up after 64 rewrites of the aging files"},
+  {"set aging files", cli_set_aging_files, "[number] Files of the aging churn, sized as the fragmented fill files"},
   {NULL}
 };
 
@@ -287,17 +362,21 @@ cmd command_list[] = {		/* table of CLI commands */
 
 extern void verbose_report ();
 extern void terse_report ();
+extern void json_report ();	/* FFSMark */
+extern void csv_report ();
 void (*reports[]) () =
 {
-verbose_report, terse_report};
+verbose_report, terse_report, json_report, csv_report};
+char *report_names[] = { "verbose", "terse", "json", "csv" };	/* FFSMark */
 
 /* Counters */
-int files_created;		/* number of files created */
-int files_deleted;		/* number of files deleted */
-int files_read;			/* number of files read */
-int files_appended;		/* number of files appended */
-float bytes_written;		/* number of bytes written to files */
-float bytes_read;		/* number of bytes read from files */
+/* FFSMark: counters are per thread, workers are merged back after the run */
+__thread int files_created;	/* number of files created */
+__thread int files_deleted;	/* number of files deleted */
+__thread int files_read;	/* number of files read */
+__thread int files_appended;	/* number of files appended */
+__thread float bytes_written;	/* number of bytes written to files */
+__thread float bytes_read;	/* number of bytes read from files */
 
 /* Configurable Parameters */
 int file_size_low = 500;
@@ -311,19 +390,196 @@ int write_block_size = 512;
 int bias_read = 5;		/* chance of picking read over append */
 int bias_create = 5;		/* chance of picking create over delete */
 int buffered_io = 1;		/* use C library buffered I/O */
-int report = 0;			/* 0=verbose, 1=terse report format */
+int report = 0;			/* 0=verbose, 1=terse report format,
+				   FFSMark: 2=JSON, 3=CSV */
+char report_path[MAX_LINE + 1];	/* FFSMark: file the JSON or CSV reports
+				   are appended to, empty=run output */
+int threads = 1;		/* FFSMark: transaction worker threads */
+int io_align = 1;		/* FFSMark: direct I/O size/offset/buffer alignment */
+double rate = 0;		/* FFSMark: offered load (tx/s), 0=closed-loop */
+int rate_poisson = 0;		/* FFSMark: 1=Poisson arrivals, 0=fixed */
+popularity_config popularity = { POPULARITY_UNIFORM };	/* FFSMark */
+size_distrib create_sizes = { SIZE_UNIFORM };	/* FFSMark: initial sizes */
+size_distrib append_sizes = { SIZE_UNIFORM };	/* FFSMark: append sizes */
+int source_binary = 0;		/* FFSMark: 1=binary junk, 0=printable */
+double compressibility = 0;	/* FFSMark: target compression ratio, 0=off */
+int content_unique = 0;		/* FFSMark: 1=data depends on file and offset,
+				   0=copied from file_source */
+double dedupe = 0;		/* FFSMark: duplicate blocks of unique content */
+int pregenerate = 0;		/* FFSMark: 1=transactions decided before timing */
+int repeat = 1;			/* FFSMark: measured iterations of a run */
+int warmup = 0;			/* FFSMark: unreported iterations before them */
+int reseed = 0;			/* FFSMark: 1=iteration i uses seed + i */
+char replay_path[MAX_LINE + 1];	/* FFSMark: trace replayed instead of the
+				   transactions, empty=none */
+int replay_timed = 0;		/* FFSMark: 1=trace timing, 0=as fast as possible */
+
+/* FFSMark: durability policies of 'set fsync' */
+#define SYNC_NONE	0	/* left to the file system */
+#define SYNC_WRITE	1	/* after each write call */
+#define SYNC_CLOSE	2	/* before each close of a written file */
+#define SYNC_EVERY	3	/* syncfs on every sync_count-th written file */
+#define SYNC_GROUP	4	/* batches of sync_count written files */
+
+char *sync_names[] = { "none", "write", "close", "every", "group" };
+int sync_policy = SYNC_NONE;	/* FFSMark: one of SYNC_* */
+int sync_count = 1;		/* FFSMark: files per sync (every, group) */
+int sync_data = 0;		/* FFSMark: 1=fdatasync, 0=fsync */
+
+/* FFSMark: operations of the weighted transaction mix ('set mix'), which
+   replaces the read/append choice of 'set bias read' */
+typedef enum
+{
+  MIX_READ = 0,
+  MIX_APPEND,
+  MIX_OVERWRITE,		/* in place, at a random offset */
+  MIX_PREAD,			/* partial read at a random offset */
+  MIX_RENAME,			/* within the directory of the file */
+  MIX_MOVE,			/* rename to another location/subdirectory */
+  MIX_STAT,
+  MIX_READDIR,			/* directory of the file */
+  MIX_LINK,			/* hard link, removed right away */
+  MIX_SYMLINK,			/* symbolic link, removed right away */
+  MIX_TRUNCATE,			/* shrink to a random length */
+  MIX_SETXATTR,
+  MIX_GETXATTR,
+  MIX_OP_NUM
+} mix_op;
+
+char *mix_names[MIX_OP_NUM] = { "read", "append", "overwrite", "pread",
+  "rename", "move", "stat", "readdir", "link", "symlink", "truncate",
+  "setxattr", "getxattr"
+};
+latency_op mix_latency[MIX_OP_NUM] = { LAT_READ, LAT_APPEND, LAT_OVERWRITE,
+  LAT_PREAD, LAT_RENAME, LAT_MOVE, LAT_STAT, LAT_READDIR, LAT_LINK,
+  LAT_SYMLINK, LAT_TRUNCATE, LAT_SETXATTR, LAT_GETXATTR
+};
+int mix_weights[MIX_OP_NUM];	/* FFSMark: weight of each operation */
+int mix_total = 0;		/* FFSMark: sum of the weights, 0=bias read */
+__thread int mix_done[MIX_OP_NUM];	/* FFSMark: metadata operations done */
+__thread int files_renamed;	/* FFSMark: renames and moves decided */
+int xattr_unsupported;		/* FFSMark: error already reported, set
+				   atomically by the workers */
+
+#define XATTR_NAME "user.ffsmark"
+#define XATTR_SIZE 64
+#define RENAME_SUFFIX 22	/* "r%u.%d" appended to renamed files */
+
+int overwrite_size = 4096;	/* FFSMark: bytes of an overwrite */
+int overwrite_align = 4096;	/* FFSMark: its offsets are multiples of it */
+int pread_size = 4096;		/* FFSMark: bytes of a partial read */
+int pread_align = 4096;		/* FFSMark: its offsets are multiples of it */
+
+/* FFSMark: minimum size of file_source with 'set compressibility' */
+#define COMPRESSIBLE_SOURCE (4 << 20)
+
+/* FFSMark: round up to the direct I/O alignment (identity when buffered) */
+#define ALIGN_UP(x) ((((x) + io_align - 1) / io_align) * io_align)
 
 /* Working Storage */
 char *file_source;		/* pointer to buffer of random text */
+int source_size;		/* FFSMark: size of file_source */
+double source_ratio;		/* FFSMark: estimated compression ratio of it */
+double source_fraction = -1;	/* FFSMark: random fraction of its chunks */
+__thread uint64_t source_writes;	/* FFSMark: writes of the thread */
+__thread char *write_buffer;	/* FFSMark: unique content being written */
+__thread int sync_every_pending;	/* FFSMark: every: written files since the
+				   last syncfs */
+__thread int sync_group_pending;	/* FFSMark: group: files in the batch */
+__thread int *sync_fds;		/* FFSMark: group: files awaiting their sync */
+__thread unsigned int *sync_ids;
+__thread optrace_record *sync_records;	/* FFSMark: sync records held back
+					   until the operation is traced */
+__thread int sync_records_num;
+__thread int sync_records_max;
 
 typedef struct
 {
   char name[MAX_FILENAME + 1];	/* name of individual file */
   int size;			/* current size of file, 0 = unused file slot */
+  unsigned int id;		/* FFSMark: unique id of the file in the run */
 } file_entry;
 
 file_entry *file_table;		/* table of files in use */
-int file_allocated;		/* pointer to last allocated slot in file_table */
+
+/* FFSMark: pre-generated transactions ('set pregenerate'), two entries per
+   transaction - a read or append, then a create or delete */
+typedef enum
+{
+  PLAN_NONE = 0,		/* locked out by a bias, or not possible */
+  PLAN_READ,
+  PLAN_APPEND,
+  PLAN_CREATE,
+  PLAN_DELETE,
+  PLAN_OVERWRITE,		/* data operations of the mix */
+  PLAN_PREAD,
+  PLAN_META			/* metadata operation of the mix */
+} plan_op;
+
+typedef struct
+{
+  plan_op op;
+  char *name;			/* file accessed */
+  int size;			/* bytes read, appended, written or deleted */
+  int offset;			/* PLAN_APPEND: length of the file before,
+				   PLAN_OVERWRITE, PLAN_PREAD: offset */
+  unsigned int id;		/* file id, for the operation trace */
+  mix_op meta;			/* PLAN_META: the operation */
+  char *target;			/* PLAN_META: new name of a rename or move */
+  unsigned int target_id;	/* PLAN_META: file id of the new name */
+} plan_entry;
+
+/* FFSMark: the file table is split into one partition per worker thread,
+   each worker only ever touches the slots of its own partition */
+typedef struct
+{
+  int base;			/* first file_table slot of the partition */
+  int size;			/* number of slots in the partition */
+  int used;			/* number of slots holding a file */
+  int unused;			/* number of free slots */
+  zipf_state zipf;		/* zipfian popularity over the ranks */
+  plan_entry *plan;		/* pre-generated transactions, or NULL */
+  int planned;			/* number of transactions in plan */
+} file_partition;
+
+/* FFSMark: O(1) slot bookkeeping, each partition owns the range
+   [base, base + size) of these arrays
+   - live_files[base .. base + used) lists the slots holding a file
+   - free_files[base .. base + unused) is a stack of free slots */
+int *live_files;		/* dense array of used slots */
+int *live_position;		/* index of each used slot in live_files */
+int *free_files;		/* stack of free slots */
+
+/* FFSMark: popularity keys of 'set popularity zipf/hotset' - a file draws a
+   random rank of [0, size) among the free ones of its partition when created
+   and keeps it until deleted, so the hot files do not change with the slot
+   bookkeeping
+   - rank_slot[base + rank] is the slot holding the rank, -1 if none
+   - slot_rank[slot] is the rank of a used slot
+   - free_ranks[base .. base + size - used) lists the ranks of no file */
+int *rank_slot;
+int *slot_rank;
+int *free_ranks;
+#define POPULARITY_TRIES 64	/* draws of a held rank before going uniform */
+unsigned int file_ids;		/* FFSMark: last file id handed out */
+
+file_partition *partitions;	/* one partition per worker thread */
+__thread file_partition *partition;	/* partition of the calling thread */
+__thread int worker = -1;	/* worker id, -1 for the main thread */
+
+/* FFSMark: transaction being pre-generated, NULL when performing I/O */
+plan_entry *planning;
+char **slot_names;		/* name of the file of each slot, while planning */
+
+#define PLAN_NAMES_BLOCK 65536
+typedef struct plan_names_struct
+{
+  struct plan_names_struct *next;
+  int used;
+  char data[PLAN_NAMES_BLOCK];
+} plan_names;
+
+plan_names *plan_name_blocks;	/* storage of the pre-generated names */
 
 typedef struct file_system_struct
 {
@@ -336,7 +592,7 @@ int file_system_weight;		/* sum of weights for all file systems */
 int file_system_count;		/* number of configured file systems */
 char **location_index;		/* weighted index of file systems */
 
-char *read_buffer;		/* temporary space for reading file data into */
+__thread char *read_buffer;	/* temporary space for reading file data into */
 
 #define RND(x) ((x>0)?(genrand() % (x)):0)
 extern unsigned long genrand ();
@@ -681,47 +937,494 @@ cli_set_bias_create (param)
   return (1);
 }
 
-/* UI callback for 'set report' - chooses verbose or terse report formats */
+/* UI callback for 'set report' - chooses verbose or terse report formats,
+   FFSMark: or JSON and CSV ones, optionally appended to a results file */
 int
 cli_set_report (param)
      char *param;		/* remainder of command line */
 {
+  char format[MAX_LINE + 1], path[MAX_LINE + 1];
+  int match = 0;
+  int n = 0;
+  int i;
+
+  if (param)
+    {
+      n = sscanf (param, "%s %s", format, path);
+      for (i = 0, match = -1; n >= 1 && i < REPORT_CSV + 1; i++)
+	if (!strcmp (format, report_names[i]))
+	  match = i;
+      if (match < REPORT_JSON && n == 2)
+	match = -1;		/* only machine readable reports have one */
+    }
+
+  if (!param || match == -1)
+    fprintf (stderr, "Error: 'verbose', 'terse', 'json [file]' or "
+	     "'csv [file]' required\n");
+  else
+    {
+      report = match;
+      strcpy (report_path, (n == 2) ? path : "");
+    }
+
+  return (1);
+}
+
+/* FFSMark: UI callback for 'set threads' - number of transaction workers */
+int
+cli_set_threads (param)
+     char *param;		/* remainder of command line */
+{
+  int value;
+
+  if (param && (value = atoi (param)) > 0)
+    threads = value;
+  else
+    fprintf (stderr, "Error: no number of threads specified\n");
+
+  return (1);
+}
+
+/* FFSMark: allocate an I/O buffer aligned for direct I/O if required */
+char *
+alloc_io_buffer (size)
+     int size;
+{
+  void *buffer;
+
+  if (io_align <= 1)
+    return ((char *) malloc (size));
+
+  if (posix_memalign (&buffer, io_align, ALIGN_UP (size)))
+    return (NULL);
+
+  return ((char *) buffer);
+}
+
+/* FFSMark: UI callback for 'set rate' - open-loop offered load */
+int
+cli_set_rate (param)
+     char *param;		/* remainder of command line */
+{
+  char mode[MAX_LINE + 1], extra[MAX_LINE + 1];
+  double value = -1;
+  int n = 0;
+
+  if (param)
+    n = sscanf (param, "%lf %s %s", &value, mode, extra);
+
+  if (n < 1 || n > 2 || value < 0 || (n == 2 && strcmp (mode, "poisson")))
+    fprintf (stderr, "Error: please indicate a rate (transactions per "
+	     "second), optionally followed by 'poisson'\n");
+  else
+    {
+      rate = value;
+      rate_poisson = (n == 2);
+    }
+
+  return (1);
+}
+
+/* FFSMark: UI callback for 'set source' - content of the written data */
+int
+cli_set_source (param)
+     char *param;		/* remainder of command line */
+{
+  if (param && !strcmp (param, "printable"))
+    source_binary = 0;
+  else if (param && !strcmp (param, "binary"))
+    source_binary = 1;
+  else
+    fprintf (stderr, "Error: please indicate printable or binary\n");
+
+  return (1);
+}
+
+/* FFSMark: UI callback for 'set compressibility' */
+int
+cli_set_compressibility (param)
+     char *param;		/* remainder of command line */
+{
+  double value;
+
+  if (param && !strcmp (param, "off"))
+    compressibility = 0;
+  else if (param && sscanf (param, "%lf", &value) == 1 && value >= 1)
+    compressibility = value;
+  else
+    fprintf (stderr, "Error: please indicate a ratio >= 1 or off\n");
+
+  return (1);
+}
+
+/* FFSMark: UI callback for 'set content' */
+int
+cli_set_content (param)
+     char *param;		/* remainder of command line */
+{
+  if (param && !strcmp (param, "shared"))
+    content_unique = 0;
+  else if (param && !strcmp (param, "unique"))
+    content_unique = 1;
+  else
+    fprintf (stderr, "Error: please indicate shared or unique\n");
+
+  return (1);
+}
+
+/* FFSMark: UI callback for 'set dedupe' */
+int
+cli_set_dedupe (param)
+     char *param;		/* remainder of command line */
+{
+  double value;
+
+  if (param && sscanf (param, "%lf", &value) == 1 && value >= 0
+      && value <= 1)
+    dedupe = value;
+  else
+    fprintf (stderr, "Error: please indicate a ratio between 0 and 1\n");
+
+  return (1);
+}
+
+/* FFSMark: UI callback for 'set repeat' */
+int
+cli_set_repeat (param)
+     char *param;		/* remainder of command line */
+{
+  char mode[MAX_LINE + 1], extra[MAX_LINE + 1];
+  int value = 0, n = 0;
+
+  if (param)
+    n = sscanf (param, "%d %s %s", &value, mode, extra);
+
+  if (n < 1 || n > 2 || value <= 0 || (n == 2 && strcmp (mode, "reseed")))
+    fprintf (stderr, "Error: please indicate a number of iterations, "
+	     "optionally followed by 'reseed'\n");
+  else
+    {
+      repeat = value;
+      reseed = (n == 2);
+    }
+
+  return (1);
+}
+
+/* FFSMark: UI callback for 'set warmup' */
+int
+cli_set_warmup (param)
+     char *param;		/* remainder of command line */
+{
+  if (param && atoi (param) >= 0)
+    warmup = atoi (param);
+  else
+    fprintf (stderr, "Error: no number of iterations specified\n");
+
+  return (1);
+}
+
+/* FFSMark: UI callback for 'set mix' - weights of the operations making
+   the first half of each transaction, 'off' going back to 'set bias read' */
+int
+cli_set_mix (param)
+     char *param;		/* remainder of command line */
+{
+  char name[MAX_LINE + 1];
+  int weights[MIX_OP_NUM];
+  int weight, used, total = 0;
   int match = 0;
+  int i;
+
+  if (param && !strcmp (param, "off"))
+    {
+      mix_total = 0;
+      return (1);
+    }
+
+  memset (weights, 0, sizeof (weights));
+  while (param && match != -1
+	 && sscanf (param, "%s %d%n", name, &weight, &used) == 2)
+    {
+      for (i = 0, match = -1; i < MIX_OP_NUM; i++)
+	if (!strcmp (name, mix_names[i]) && weight >= 0)
+	  match = i;
+      if (match != -1)
+	{
+	  weights[match] = weight;
+	  total += weight;
+	  param += used;
+	}
+    }
+
+  if (!param || sscanf (param, "%s", name) == 1 || total == 0)
+    {
+      fprintf (stderr, "Error: 'off' or operation and weight pairs "
+	       "required, operations being");
+      for (i = 0; i < MIX_OP_NUM; i++)
+	fprintf (stderr, " %s", mix_names[i]);
+      fprintf (stderr, "\n");
+      return (1);
+    }
+
+  memcpy (mix_weights, weights, sizeof (weights));
+  mix_total = total;
+  return (1);
+}
+
+/* FFSMark: parses the 'bytes [alignment]' of 'set overwrite' and
+   'set pread' */
+int
+parse_partial (param, size, align)
+     char *param;		/* remainder of command line */
+     int *size;
+     int *align;
+{
+  int bytes, alignment = *align;
+
+  if (!param || sscanf (param, "%d %d", &bytes, &alignment) < 1
+      || bytes < 1 || alignment < 1)
+    {
+      fprintf (stderr, "Error: a size in bytes, optionally followed by "
+	       "the alignment of the offsets (1 for unaligned), required\n");
+      return (1);
+    }
+
+  *size = bytes;
+  *align = alignment;
+  return (1);
+}
+
+/* FFSMark: UI callback for 'set overwrite' */
+int
+cli_set_overwrite (param)
+     char *param;		/* remainder of command line */
+{
+  return (parse_partial (param, &overwrite_size, &overwrite_align));
+}
+
+/* FFSMark: UI callback for 'set pread' */
+int
+cli_set_pread (param)
+     char *param;		/* remainder of command line */
+{
+  return (parse_partial (param, &pread_size, &pread_align));
+}
+
+/* FFSMark: UI callback for 'set fsync' - durability policy of the written
+   files and the sync call making them durable */
+int
+cli_set_fsync (param)
+     char *param;		/* remainder of command line */
+{
+  char policy[MAX_LINE + 1], call[MAX_LINE + 1];
+  int count = 1;
+  int n = 0;
+  int match = -1;
+  int i;
 
   if (param)
+    n = sscanf (param, "%s %s", policy, call);
+  for (i = 0; n >= 1 && i <= SYNC_GROUP; i++)
+    if (!strcmp (policy, sync_names[i]))
+      match = i;
+
+  /* every and group are followed by their number of files */
+  if (match == SYNC_EVERY || match == SYNC_GROUP)
+    {
+      n = sscanf (param, "%*s %d %s", &count, call) + 1;
+      if (n < 2 || count < 1)
+	match = -1;
+    }
+  else if (n == 2)
+    n = 3;			/* the sync call, if any, in the same place */
+
+  if (match != -1 && n == 3)
     {
-      if (!strcmp (param, "verbose"))
-	report = 0;
-      else if (!strcmp (param, "terse"))
-	report = 1;
+      if (!strcmp (call, "fdatasync"))
+	sync_data = 1;
+      else if (!strcmp (call, "fsync"))
+	sync_data = 0;
       else
 	match = -1;
     }
 
-  if (!param || match == -1)
-    fprintf (stderr, "Error: either 'verbose' or 'terse' required\n");
+  if (match == -1)
+    {
+      fprintf (stderr, "Error: 'none', 'write', 'close', 'every N' or "
+	       "'group N' required, optionally followed by 'fsync' or "
+	       "'fdatasync'\n");
+      return (1);
+    }
+
+  sync_policy = match;
+  sync_count = count;
+  return (1);
+}
+
+/* FFSMark: UI callback for 'set pregenerate' */
+int
+cli_set_pregenerate (param)
+     char *param;		/* remainder of command line */
+{
+  if (param && !strcmp (param, "true"))
+    pregenerate = 1;
+  else if (param && !strcmp (param, "false"))
+    pregenerate = 0;
+  else
+    fprintf (stderr, "Error: please indicate true or false\n");
+
+  return (1);
+}
+
+/* FFSMark: UI callback for 'set replay' - recorded trace replacing the
+   transactions */
+int
+cli_set_replay (param)
+     char *param;		/* remainder of command line */
+{
+  char *token;
+
+  if (param && !strcmp (param, "off"))
+    replay_path[0] = '\0';
+  else if (param && strlen (param) <= MAX_LINE)
+    {
+      strcpy (replay_path, param);
+      replay_timed = 0;
+      if ((token = strchr (replay_path, ' ')) != NULL)
+	{
+	  *token++ = '\0';
+	  if (!strcmp (token, "timed"))
+	    replay_timed = 1;
+	  else if (strcmp (token, "afap"))
+	    {
+	      fprintf (stderr, "Error: replay mode must be afap or timed\n");
+	      replay_path[0] = '\0';
+	    }
+	}
+    }
+  else
+    fprintf (stderr, "Error: no trace file specified\n");
+
+  return (1);
+}
+
+/* FFSMark: UI callback for 'set popularity' - skew of file selection */
+int
+cli_set_popularity (param)
+     char *param;		/* remainder of command line */
+{
+  popularity_parse (param, &popularity);
+
+  return (1);
+}
+
+/* FFSMark: UI callbacks for 'set distribution' - file and append sizes */
+int
+cli_set_distribution_create (param)
+     char *param;		/* remainder of command line */
+{
+  size_distrib_parse (param, &create_sizes);
+
+  return (1);
+}
+
+int
+cli_set_distribution_append (param)
+     char *param;		/* remainder of command line */
+{
+  size_distrib_parse (param, &append_sizes);
 
   return (1);
 }
 
+/* FFSMark: initial size of a new file */
+int
+next_file_size ()
+{
+  if (create_sizes.type == SIZE_UNIFORM)
+    return (file_size_low + RND (file_size_high - file_size_low));
+
+  return (size_distrib_next (&create_sizes));
+}
+
+/* FFSMark: size of an append to a file of 'size' bytes */
+int
+next_append_size (size)
+     int size;
+{
+  int block;
+
+  if (append_sizes.type == SIZE_UNIFORM)
+    return (RND (file_size_high - size) + 1);
+
+  block = size_distrib_next (&append_sizes);
+  return ((block < file_size_high - size) ? block : file_size_high - size);
+}
+
 /* populate file source buffer with 'size' bytes of readable randomness */
+/* FFSMark: generated by words from a single draw instead of one draw per
+   byte, binary when 'set source binary' */
 char *
 initialize_file_source (size)
      int size;			/* number of bytes of junk to create */
 {
   char *new_source;
-  int i;
 
-  if ((new_source = (char *) malloc (size)) == NULL)	/* allocate buffer */
+  if ((new_source = alloc_io_buffer (size)) == NULL)	/* allocate buffer */
     fprintf (stderr, "Error: failed to allocate source file of size %d\n",
 	     size);
-  else
-    for (i = 0; i < size; i++)	/* file buffer with junk */
-      new_source[i] = 32 + RND (95);
+  else if (compressibility > 0)	/* FFSMark: chunks of tuned redundancy */
+    {
+      uint64_t source_seed = genrand ();
+      int i;
+
+      source_fraction = datagen_calibrate (compressibility, source_seed);
+      for (i = 0; i < size; i += DATAGEN_CHUNK)
+	datagen_chunk (new_source + i, (size - i < DATAGEN_CHUNK) ?
+		       size - i : DATAGEN_CHUNK, source_seed, i / DATAGEN_CHUNK,
+		       source_fraction);
+      source_ratio = (double) size / datagen_lz_estimate (new_source, size);
+    }
+  else				/* file buffer with junk */
+    {
+      source_fraction = -1;
+      datagen_fill (new_source, size, genrand (), 0, !source_binary);
+    }
 
   return (new_source);
 }
 
+/* FFSMark: data of the next write of 'size' bytes at 'offset' of file
+   'id' - generated in write_buffer with 'set content unique', otherwise
+   part of file_source: its start unless 'set compressibility', where a
+   counter-based draw (not the transaction generator, so pre-generated runs
+   stay identical) picks a chunk for the content of every file to differ */
+char *
+write_source (size, id, offset)
+     int size;
+     unsigned int id;
+     uint64_t offset;
+{
+  int chunks;
+
+  if (content_unique)
+    {
+      datagen_content content =
+	{ seed, dedupe, source_fraction, !source_binary };
+
+      datagen_content_fill (&content, write_buffer, size, id, offset);
+      return (write_buffer);
+    }
+
+  if (compressibility == 0 || size >= source_size)
+    return (file_source);
+
+  chunks = (source_size - size) / DATAGEN_CHUNK + 1;
+  return (file_source + (datagen_word (seed + worker + 1, source_writes++)
+			 % chunks) * DATAGEN_CHUNK);
+}
+
 /* returns differences in times -
    1 second is the minimum to avoid divide by zero errors */
 time_t
@@ -744,6 +1447,7 @@ verbose_report (fp, end_time, start_time, t_end_time, t_start_time, deleted)
   double elapsed_double, t_elapsed_double, interval_double;
   //int interval;
   struct timeval res;
+  int i;			/* FFSMark: mix operation iterator */
 
   //elapsed=diff_time(end_time,start_time);
   //t_elapsed=diff_time(t_end_time,t_start_time);
@@ -782,6 +1486,14 @@ verbose_report (fp, end_time, start_time, t_end_time, t_start_time, deleted)
 	   (double) files_read / t_elapsed_double);
   fprintf (fp, "\t%d appended (%lf per second)\n", files_appended,
 	   (double) files_appended / t_elapsed_double);
+  if (mix_total && mix_weights[MIX_OVERWRITE])	/* FFSMark */
+    fprintf (fp, "\t%d overwritten in place (%lf per second)\n",
+	     mix_done[MIX_OVERWRITE],
+	     (double) mix_done[MIX_OVERWRITE] / t_elapsed_double);
+  if (mix_total && mix_weights[MIX_PREAD])
+    fprintf (fp, "\t%d partially read (%lf per second)\n",
+	     mix_done[MIX_PREAD],
+	     (double) mix_done[MIX_PREAD] / t_elapsed_double);
   fprintf (fp, "\t%d deleted (%lf per second)\n", files_created,
 	   (double) files_created / elapsed_double);
 
@@ -794,11 +1506,31 @@ verbose_report (fp, end_time, start_time, t_end_time, t_start_time, deleted)
 	   files_deleted - deleted,
 	   (double) (files_deleted - deleted) / t_elapsed_double);
 
+  if (mix_total)			/* FFSMark */
+    {
+      fprintf (fp, "\nMetadata:\n");
+      for (i = MIX_RENAME; i < MIX_OP_NUM; i++)
+	if (mix_weights[i])
+	  fprintf (fp, "\t%d %s (%lf per second)\n", mix_done[i],
+		   mix_names[i], (double) mix_done[i] / t_elapsed_double);
+    }
+
   fprintf (fp, "\nData:\n");
   fprintf (fp, "\t%s read ", scalef (bytes_read));
   fprintf (fp, "(%s per second)\n", scalef (bytes_read / elapsed_double));
   fprintf (fp, "\t%s written ", scalef (bytes_written));
   fprintf (fp, "(%s per second)\n", scalef (bytes_written / elapsed_double));
+  if (compressibility > 0)	/* FFSMark */
+    fprintf (fp, "\tCompressibility %.2lf:1 achieved (target %.2lf:1, LZ "
+	     "estimate over 4KiB chunks)\n", source_ratio, compressibility);
+
+  latency_report (fp);		/* FFSMark */
+  if (rate > 0)
+    fprintf (fp, "\tTransaction latencies measured from their intended "
+	     "start (open-loop, %.2lf tx/s)\n", rate);
+  if (replay_path[0])
+    fprintf (fp, "\tTransactions replayed from %s (%s)\n", replay_path,
+	     replay_timed ? "trace timing" : "as fast as possible");
 
   ffsmark_core_verb_report(fp);
 }
@@ -824,7 +1556,9 @@ terse_report (fp, end_time, start_time, t_end_time, t_start_time, deleted)
   t_elapsed_double = res.tv_sec + (res.tv_usec / 1000000.0);
 
   //interval=diff_time(t_start_time,start_time);
-  timersub (&res, &ffsmark_transaction_start, &ffsmark_start);
+  /* FFSMark: was timersub (&res, &ffsmark_transaction_start, &ffsmark_start),
+     overwriting the start of the run */
+  timersub (&ffsmark_transaction_start, &ffsmark_start, &res);
   interval_double = res.tv_sec + (res.tv_usec / 1000000.0);
 
   fprintf (fp, "%lf %lf %.2lf ", elapsed_double, t_elapsed_double,
@@ -837,72 +1571,617 @@ terse_report (fp, end_time, start_time, t_end_time, t_start_time, deleted)
   fprintf (fp, "%.2lf %.2lf %.2lf ", (double) files_created / elapsed_double,
 	   (double) deleted / interval_double,
 	   (double) (files_deleted - deleted) / t_elapsed_double);
-  fprintf (fp, "%.2f %.2f\n", (double) bytes_read / elapsed_double,
+  fprintf (fp, "%.2f %.2f", (double) bytes_read / elapsed_double,
 	   (double) bytes_written / elapsed_double);
+  ffsmark_core_terse_report (fp);	/* FFSMark: flash counters */
+  fprintf (fp, "\n");
 }
 
-/* returns file_table entry of unallocated file
-   - if not at end of table, then return next entry
-   - else search table for gaps */
-int
-find_free_file ()
+/* FFSMark: timeval difference in seconds */
+double
+elapsed_seconds (end, start)
+     struct timeval *end, *start;
 {
-  int i;
-
-  if (file_allocated < simultaneous << 1
-      && file_table[file_allocated].size == 0)
-    return (file_allocated++);
-  else				/* search entire table for holes */
-    for (i = 0; i < simultaneous << 1; i++)
-      if (file_table[i].size == 0)
-	{
-	  file_allocated = i;
-	  return (file_allocated++);
-	}
+  struct timeval res;
 
-  return (-1);			/* return -1 only if no free files found */
+  timersub (end, start, &res);
+  return res.tv_sec + (res.tv_usec / 1000000.0);
 }
 
-/* write 'size' bytes to file 'fd' using unbuffered I/O */
+/* FFSMark: configuration and results of the iteration as report fields,
+   grouped by key prefix */
 void
-write_blocks (fd, size)
-     int fd;
+report_fields (deleted)
+     int deleted;		/* files deleted back-to-back */
+{
+  double elapsed, t_elapsed, creation, deletion;
+  char stamp[32];
+  char key[REPORT_KEY_LEN];
+  int i;
+  time_t now = time (NULL);
+
+  elapsed = elapsed_seconds (&ffsmark_end, &ffsmark_start);
+  t_elapsed = elapsed_seconds (&ffsmark_transaction_end,
+			       &ffsmark_transaction_start);
+  creation = elapsed_seconds (&ffsmark_transaction_start, &ffsmark_start);
+  deletion = elapsed_seconds (&ffsmark_end, &ffsmark_transaction_end);
+  strftime (stamp, sizeof (stamp), "%Y-%m-%dT%H:%M:%SZ", gmtime (&now));
+
+  report_reset ();
+  report_string ("run.timestamp", stamp);
+  report_integer ("run.iteration", results_iterations ());
+  report_integer ("run.seed", seed);
+
+  report_integer ("config.file_size_low", file_size_low);
+  report_integer ("config.file_size_high", file_size_high);
+  report_integer ("config.simultaneous", simultaneous);
+  report_integer ("config.transactions", transactions);
+  report_integer ("config.subdirectories", subdirectories);
+  report_integer ("config.read_block_size", read_block_size);
+  report_integer ("config.write_block_size", write_block_size);
+  report_integer ("config.bias_read", bias_read);
+  report_integer ("config.bias_create", bias_create);
+  report_integer ("config.buffered_io", buffered_io);
+  report_integer ("config.threads", threads);
+  report_number ("config.rate", rate);
+  report_number ("config.compressibility", compressibility);
+  report_integer ("config.content_unique", content_unique);
+  report_number ("config.dedupe", dedupe);
+  report_integer ("config.pregenerate", pregenerate);
+  for (i = 0; i < MIX_OP_NUM; i++)
+    {
+      sprintf (key, "config.mix.%s", mix_names[i]);
+      report_integer (key, mix_total ? mix_weights[i] : 0);
+    }
+  report_integer ("config.overwrite.size", overwrite_size);
+  report_integer ("config.overwrite.alignment", overwrite_align);
+  report_integer ("config.pread.size", pread_size);
+  report_integer ("config.pread.alignment", pread_align);
+  report_string ("config.fsync.policy", sync_names[sync_policy]);
+  report_integer ("config.fsync.files", sync_count);
+  report_string ("config.fsync.call", (sync_policy == SYNC_EVERY) ? "syncfs"
+		 : sync_data ? "fdatasync" : "fsync");
+  ffsmark_core_report_fields ();
+
+  report_number ("time.total_s", elapsed);
+  report_number ("time.creation_s", creation);
+  report_number ("time.transactions_s", t_elapsed);
+  report_number ("time.deletion_s", deletion);
+
+  report_integer ("files.created", files_created);
+  report_integer ("files.created_alone", simultaneous);
+  report_integer ("files.read", files_read);
+  report_integer ("files.appended", files_appended);
+  report_integer ("files.overwritten", mix_done[MIX_OVERWRITE]);
+  report_integer ("files.partially_read", mix_done[MIX_PREAD]);
+  report_integer ("files.deleted", files_deleted);
+  report_integer ("files.deleted_alone", deleted);
+
+  report_number ("rate.transactions_per_s", transactions / t_elapsed);
+  report_number ("rate.created_per_s", files_created / elapsed);
+  report_number ("rate.created_alone_per_s", simultaneous / creation);
+  report_number ("rate.created_mixed_per_s",
+		 (files_created - simultaneous) / t_elapsed);
+  report_number ("rate.read_per_s", files_read / t_elapsed);
+  report_number ("rate.appended_per_s", files_appended / t_elapsed);
+  report_number ("rate.overwritten_per_s",
+		 mix_done[MIX_OVERWRITE] / t_elapsed);
+  report_number ("rate.partially_read_per_s", mix_done[MIX_PREAD] / t_elapsed);
+  report_number ("rate.deleted_per_s", files_deleted / elapsed);
+  report_number ("rate.deleted_alone_per_s", deleted / deletion);
+  report_number ("rate.deleted_mixed_per_s",
+		 (files_deleted - deleted) / t_elapsed);
+
+  report_number ("data.read_bytes", bytes_read);
+  report_number ("data.written_bytes", bytes_written);
+  report_number ("data.read_mb_per_s", bytes_read / elapsed / MEGABYTE);
+  report_number ("data.written_mb_per_s",
+		 bytes_written / elapsed / MEGABYTE);
+  report_number ("data.compressibility",
+		 (compressibility > 0) ? source_ratio : NAN);
+
+  for (i = MIX_RENAME; i < MIX_OP_NUM; i++)
+    {
+      sprintf (key, "metadata.%s.count", mix_names[i]);
+      report_integer (key, mix_done[i]);
+      sprintf (key, "metadata.%s.per_s", mix_names[i]);
+      report_number (key, mix_done[i] / t_elapsed);
+    }
+
+  latency_report_fields ();
+}
+
+/* FFSMark: output of the JSON and CSV reports, the 'set report' file when
+   given */
+FILE *
+report_open (fp)
+     FILE *fp;			/* run output */
+{
+  FILE *out;
+
+  if (!report_path[0])
+    return fp;
+
+  if ((out = fopen (report_path, "a")) == NULL)
+    {
+      fprintf (stderr, "Error: Cannot append the report to '%s'\n",
+	       report_path);
+      return fp;
+    }
+
+  return out;
+}
+
+/* FFSMark: one JSON object per line, so that runs can be appended */
+void
+json_report (fp, end_time, start_time, t_end_time, t_start_time, deleted)
+     FILE *fp;
+     time_t end_time, start_time, t_end_time, t_start_time;	/* timers from run */
+     int deleted;		/* files deleted back-to-back */
+{
+  FILE *out = report_open (fp);
+
+  (void) end_time;		/* report_fields reads the run timers */
+  (void) start_time;
+  (void) t_end_time;
+  (void) t_start_time;
+  report_fields (deleted);
+  report_write_json (out);
+  if (out != fp)
+    fclose (out);
+}
+
+/* FFSMark: one CSV row, preceded by the header when the output is empty
+   (or not a file, on the first iteration) */
+void
+csv_report (fp, end_time, start_time, t_end_time, t_start_time, deleted)
+     FILE *fp;
+     time_t end_time, start_time, t_end_time, t_start_time;	/* timers from run */
+     int deleted;		/* files deleted back-to-back */
+{
+  FILE *out = report_open (fp);
+  long position;
+
+  (void) end_time;		/* report_fields reads the run timers */
+  (void) start_time;
+  (void) t_end_time;
+  (void) t_start_time;
+
+  fseek (out, 0, SEEK_END);
+  position = ftell (out);
+
+  report_fields (deleted);
+  report_write_csv (out, position == 0 ||
+		    (position < 0 && results_iterations () == 1));
+  if (out != fp)
+    fclose (out);
+}
+
+/* FFSMark: trace operations matching the latency_op entries, the metadata
+   operations of the mix which leave the files as they are having none
+   (OPTRACE_OP_NUM) */
+optrace_op trace_ops[LAT_OP_NUM] = { OPTRACE_CREATE, OPTRACE_READ,
+  OPTRACE_APPEND, OPTRACE_DELETE, OPTRACE_OPEN, OPTRACE_CLOSE, OPTRACE_WRITE,
+  OPTRACE_FSYNC, OPTRACE_RENAME, OPTRACE_RENAME, OPTRACE_OP_NUM,
+  OPTRACE_OP_NUM, OPTRACE_OP_NUM, OPTRACE_OP_NUM, OPTRACE_TRUNCATE,
+  OPTRACE_OP_NUM, OPTRACE_OP_NUM, OPTRACE_WRITE, OPTRACE_READ
+};
+
+/* FFSMark: traces the sync records held back by sync_file */
+void
+sync_trace ()
+{
+  optrace_record *rec;
+  int i;
+
+  for (i = 0; i < sync_records_num; i++)
+    {
+      rec = &sync_records[i];
+      optrace_add (OPTRACE_FSYNC, rec->file_id, 0, 0, rec->aux, rec->start,
+		   rec->end, rec->result);
+    }
+
+  sync_records_num = 0;
+}
+
+/* FFSMark: account for an operation on file 'id' started at 'start',
+   result being 0 or -errno */
+void
+op_done (op, id, offset, size, start, result)
+     latency_op op;
+     unsigned int id;
+     uint64_t offset;
+     int size;
+     uint64_t start;
+     int result;
+{
+  uint64_t end = latency_now ();
+
+  if (!result)
+    latency_record_ns (op, end - start);
+
+  optrace_add (trace_ops[op], id, offset, size, 0, start, end, result);
+  if (sync_records_num)
+    sync_trace ();
+}
+
+/* FFSMark: fsync or fdatasync of file 'id', or syncfs of its file system if
+   'fs' is set, timed as LAT_SYNC - the trace record waits for the one of the
+   operation writing the file (op_done), so that a replay creates the file
+   before syncing it */
+void
+sync_file (fd, id, fs)
+     int fd;
+     unsigned int id;
+     int fs;
+{
+  optrace_record *rec;
+  uint64_t start = latency_now ();
+  int result = (fs ? syncfs (fd) : sync_data ? fdatasync (fd) : fsync (fd))
+    ? -errno : 0;
+  uint64_t end = latency_now ();
+  int aux = fs ? OPTRACE_FSYNC_FS : sync_data ? OPTRACE_FSYNC_DATA : 0;
+
+  if (!result)
+    latency_record_ns (LAT_SYNC, end - start);
+
+  if (sync_records_num == sync_records_max)
+    {
+      rec = (optrace_record *) realloc (sync_records,
+					(sync_records_max + 16) *
+					sizeof (optrace_record));
+      if (!rec)
+	{			/* traced out of order rather than lost */
+	  optrace_add (OPTRACE_FSYNC, id, 0, 0, aux, start, end, result);
+	  return;
+	}
+      sync_records = rec;
+      sync_records_max += 16;
+    }
+
+  rec = &sync_records[sync_records_num++];
+  rec->file_id = id;
+  rec->aux = aux;
+  rec->start = start;
+  rec->end = end;
+  rec->result = result;
+}
+
+/* FFSMark: syncs the files of the pending group commit batch, in the order
+   they were written, then closes them */
+void
+sync_flush ()
+{
+  int i;
+
+  for (i = 0; sync_fds && i < sync_group_pending; i++)
+    {
+      sync_file (sync_fds[i], sync_ids[i], 0);
+      close (sync_fds[i]);
+    }
+
+  free (sync_fds);
+  free (sync_ids);
+  sync_fds = NULL;
+  sync_ids = NULL;
+  sync_group_pending = 0;
+}
+
+/* FFSMark: end of a phase - last group commit batch, traced at once */
+void
+sync_finish ()
+{
+  sync_flush ();
+  sync_trace ();
+  free (sync_records);
+  sync_records = NULL;
+  sync_records_max = 0;
+}
+
+/* FFSMark: drops file 'id', about to be deleted, from the pending group
+   commit batch, which would otherwise sync an unlinked file */
+void
+sync_forget (id)
+     unsigned int id;
+{
+  int i;
+
+  for (i = 0; sync_fds && i < sync_group_pending; i++)
+    if (sync_ids[i] == id)
+      {
+	close (sync_fds[i]);
+	sync_group_pending--;
+	memmove (&sync_fds[i], &sync_fds[i + 1],
+		 (sync_group_pending - i) * sizeof (int));
+	memmove (&sync_ids[i], &sync_ids[i + 1],
+		 (sync_group_pending - i) * sizeof (unsigned int));
+	return;
+      }
+}
+
+/* FFSMark: 'set fsync' policy once file 'id' is written, before 'fd' is
+   closed - fd is -1 when io_uring wrote the file and closed it already.
+   The 'every' policy does not sync the file alone: one syncfs() makes it and
+   the files written since the previous one durable together */
+void
+sync_written (fd, name, id)
+     int fd;
+     char *name;
+     unsigned int id;
+{
+  int own = -1;			/* descriptor opened here */
+
+  if (sync_policy == SYNC_NONE || (sync_policy == SYNC_WRITE && fd != -1))
+    return;			/* nothing to do, or done by each write */
+
+  if (sync_policy == SYNC_EVERY && ++sync_every_pending < sync_count)
+    return;
+
+  if (fd == -1 && (fd = own = open (name, O_RDONLY)) == -1)
+    {
+      fprintf (stderr, "Error: cannot open '%s' to sync it\n", name);
+      return;
+    }
+
+  /* group commit: the file is kept open until its batch is complete */
+  if (sync_policy == SYNC_GROUP)
+    {
+      if (!sync_fds)
+	{
+	  sync_fds = (int *) malloc (sync_count * sizeof (int));
+	  sync_ids = (unsigned int *) malloc (sync_count *
+					      sizeof (unsigned int));
+	}
+
+      if (own == -1)
+	own = dup (fd);
+      if (!sync_fds || !sync_ids || own == -1)
+	{
+	  fprintf (stderr, "Error: cannot add '%s' to the sync batch\n",
+		   name);
+	  if (own != -1)
+	    close (own);
+	  return;
+	}
+
+      sync_fds[sync_group_pending] = own;
+      sync_ids[sync_group_pending++] = id;
+      if (sync_group_pending == sync_count)
+	sync_flush ();
+      return;
+    }
+
+  sync_every_pending = 0;
+  sync_file (fd, id, sync_policy == SYNC_EVERY);
+  if (own != -1)
+    close (own);
+}
+
+/* FFSMark: copy of 'name' kept until the end of the run */
+char *
+plan_name (name)
+     char *name;
+{
+  int length = strlen (name) + 1;
+  plan_names *block = plan_name_blocks;
+  char *copy;
+
+  if (block == NULL || block->used + length > PLAN_NAMES_BLOCK)
+    {
+      if ((block = (plan_names *) malloc (sizeof (plan_names))) == NULL)
+	{
+	  fprintf (stderr, "Error: Failed to allocate file names\n");
+	  exit (EXIT_FAILURE);
+	}
+      block->next = plan_name_blocks;
+      block->used = 0;
+      plan_name_blocks = block;
+    }
+
+  copy = block->data + block->used;
+  memcpy (copy, name, length);
+  block->used += length;
+
+  return (copy);
+}
+
+/* FFSMark: store an operation on slot 'number' in the transaction being
+   planned */
+void
+plan_add (op, number, size, offset)
+     plan_op op;
+     int number;		/* file_table slot */
+     int size;
+     int offset;
+{
+  plan_entry *entry = &planning[op == PLAN_CREATE || op == PLAN_DELETE];
+
+  if (op == PLAN_CREATE)
+    slot_names[number] = plan_name (file_table[number].name);
+
+  entry->op = op;
+  entry->name = slot_names[number];
+  entry->size = size;
+  entry->offset = offset;
+  entry->id = file_table[number].id;
+}
+
+/* returns file_table entry of unallocated file */
+/* FFSMark: popped from the free slot stack of the calling thread's
+   partition instead of scanning the table for holes */
+int
+find_free_file ()
+{
+  if (partition->unused == 0)
+    return (-1);		/* return -1 only if no free files found */
+
+  return (free_files[partition->base + --partition->unused]);
+}
+
+/* FFSMark: record slot 'number' as holding a file */
+void
+mark_file_used (number)
+     int number;
+{
+  int position = partition->base + partition->used++;
+  int *rank;
+
+  live_files[position] = number;
+  live_position[number] = position;
+
+  if (popularity.type != POPULARITY_UNIFORM)
+    {				/* swap-remove a random free rank */
+      rank = &free_ranks[partition->base +
+			 RND (partition->size - partition->used + 1)];
+      slot_rank[number] = *rank;
+      rank_slot[partition->base + *rank] = number;
+      *rank = free_ranks[partition->base + partition->size - partition->used];
+    }
+}
+
+/* FFSMark: swap-remove slot 'number' from the live files, push it on the
+   free slot stack */
+void
+mark_file_free (number)
+     int number;
+{
+  int last = live_files[partition->base + --partition->used];
+
+  live_files[live_position[number]] = last;
+  live_position[last] = live_position[number];
+
+  if (popularity.type != POPULARITY_UNIFORM)
+    {				/* the file's rank is free again */
+      rank_slot[partition->base + slot_rank[number]] = -1;
+      free_ranks[partition->base + partition->size - partition->used - 1] =
+	slot_rank[number];
+    }
+
+  free_files[partition->base + partition->unused++] = number;
+}
+
+/* write 'size' bytes to file 'fd' using unbuffered I/O */
+void
+write_blocks (fd, size, id, start)
+     int fd;
      int size;			/* bytes to write to file */
+     unsigned int id;		/* FFSMark: file id, for unique content */
+     int start;			/* FFSMark: offset of the write in the file */
 {
   int offset = 0;		/* offset into file */
   int i;
+  char *source = write_source (size, id, start);	/* FFSMark */
 
   /* write even blocks */
   for (i = size; i >= write_block_size;
        i -= write_block_size, offset += write_block_size)
-    write (fd, file_source + offset, write_block_size);
+    {
+      ffsmark_core_write (fd, source + offset, write_block_size);
+      if (sync_policy == SYNC_WRITE)	/* FFSMark */
+	sync_file (fd, id, 0);
+    }
 
-  write (fd, file_source + offset, i);	/* write remainder */
+  /* write remainder (FFSMark: sizes are already aligned for direct I/O) */
+  ffsmark_core_write (fd, source + offset, i);
+  if (i && sync_policy == SYNC_WRITE)	/* FFSMark */
+    sync_file (fd, id, 0);
 
   bytes_written += size;	/* update counter */
+  interval_add_bytes (0, size);	/* FFSMark */
 }
 
 /* write 'size' bytes to file 'fp' using buffered I/O */
 void
-fwrite_blocks (fp, size)
+fwrite_blocks (fp, size, id, start)
      FILE *fp;
      int size;			/* bytes to write to file */
+     unsigned int id;		/* FFSMark: file id, for unique content */
+     int start;			/* FFSMark: offset of the write in the file */
 {
   int offset = 0;		/* offset into file */
   int i;
+  char *source = write_source (size, id, start);	/* FFSMark */
 
   /* write even blocks */
   for (i = size; i >= write_block_size;
        i -= write_block_size, offset += write_block_size)
-    fwrite (file_source + offset, write_block_size, 1, fp);
+    {
+      fwrite (source + offset, write_block_size, 1, fp);
+      if (sync_policy == SYNC_WRITE)	/* FFSMark: the write reaches the file */
+	{
+	  fflush (fp);
+	  sync_file (fileno (fp), id, 0);
+	}
+    }
+
+  fwrite (source + offset, i, 1, fp);	/* write remainder */
+  if (i && sync_policy == SYNC_WRITE)	/* FFSMark */
+    {
+      fflush (fp);
+      sync_file (fileno (fp), id, 0);
+    }
+
+  bytes_written += size;	/* update counter */
+  interval_add_bytes (0, size);	/* FFSMark */
+}
+
+/* FFSMark: write 'size' bytes at 'offset' of file 'name' through io_uring */
+int
+uring_write_blocks (name, flags, offset, size, id)
+     char *name;
+     int flags;
+     int offset;
+     int size;			/* bytes to write to file */
+     unsigned int id;		/* file id, for unique content */
+{
+  int done;
+  char *source = write_source (size, id, offset);
 
-  fwrite (file_source + offset, i, 1, fp);	/* write remainder */
+  done = uring_engine_write (name, flags, 0644, offset, source, size,
+			     write_block_size);
+
+  /* fall back to buffered I/O if direct I/O was refused */
+  if (done != size && (flags & O_DIRECT))
+    {
+      ffsmark_core_direct_fallback ();
+      done = uring_engine_write (name, flags & ~O_DIRECT, 0644, offset,
+				 source, size, write_block_size);
+    }
+
+  if (done == -1)
+    return (-1);
 
   bytes_written += size;	/* update counter */
+  interval_add_bytes (0, size);
+  return (0);
+}
+
+/* FFSMark: read the 'size' bytes of file 'name' through io_uring */
+int
+uring_read_blocks (name, offset, size)
+     char *name;
+     int offset;
+     int size;			/* bytes to read from file */
+{
+  int done;
+
+  done = uring_engine_read (name, O_RDONLY | open_flags, offset, read_buffer,
+			    size, read_block_size);
+
+  /* fall back to buffered I/O if direct I/O was refused */
+  if (done != size && (open_flags & O_DIRECT))
+    {
+      ffsmark_core_direct_fallback ();
+      done = uring_engine_read (name, O_RDONLY | (open_flags & ~O_DIRECT),
+				offset, read_buffer, size, read_block_size);
+    }
+
+  return ((done == -1) ? -1 : 0);
 }
 
+/* FFSMark: directory of a new file, from create_file_name */
 void
-create_file_name (dest)
+file_dir_name (dest)
      char *dest;
 {
   char conversion[MAX_LINE + 1];
@@ -921,49 +2200,120 @@ create_file_name (dest)
       sprintf (conversion, "s%ld%s", RND (subdirectories), SEPARATOR);
       strcat (dest, conversion);
     }
+}
+
+void
+create_file_name (dest)
+     char *dest;
+{
+  char conversion[MAX_LINE + 1];
+
+  file_dir_name (dest);		/* FFSMark */
 
-  sprintf (conversion, "%d", ++files_created);
+  /* FFSMark: workers prefix names with their id to keep them unique */
+  if (worker >= 0)
+    sprintf (conversion, "t%d.%d", worker, ++files_created);
+  else
+    sprintf (conversion, "%d", ++files_created);
   strcat (dest, conversion);
 }
 
-/* creates new file of specified length and fills it with data */
+/* FFSMark: the I/O part of create_file - writes 'size' bytes to new file
+   'name' */
 void
-create_file (buffered)
+create_file_io (name, size, id, buffered)
+     char *name;		/* file to create */
+     int size;			/* initial length */
+     unsigned int id;		/* file id, for the operation trace */
      int buffered;		/* 1=buffered I/O (default), 0=unbuffered I/O */
 {
   FILE *fp = NULL;
   int fd = -1;
+  uint64_t start = latency_now ();
+
+  if (buffered)
+    fp = fopen (name, "w");
+  else if (io_engine == IO_ENGINE_URING)	/* whole access */
+    fd = uring_write_blocks (name, O_RDWR | O_CREAT | open_flags, 0, size,
+			     id);
+  else
+    fd = ffsmark_core_open (name, O_RDWR | O_CREAT | open_flags, 0644);
+
+  if (fp || fd != -1)
+    {
+      if (buffered)
+	{
+	  fwrite_blocks (fp, size, id, 0);
+	  fflush (fp);		/* FFSMark */
+	  sync_written (fileno (fp), name, id);
+	  fclose (fp);
+	}
+      else if (io_engine != IO_ENGINE_URING)
+	{
+	  write_blocks (fd, size, id, 0);
+	  sync_written (fd, name, id);	/* FFSMark */
+	  close (fd);
+	}
+      else
+	sync_written (-1, name, id);	/* FFSMark */
+
+      op_done (LAT_CREATE, id, 0, size, start, 0);
+    }
+  else
+    {
+      op_done (LAT_CREATE, id, 0, 0, start, -errno);
+      fprintf (stderr, "Error: cannot open '%s' for writing\n", name);
+    }
+}
+
+/* creates new file of specified length and fills it with data */
+void
+create_file (buffered)
+     int buffered;		/* 1=buffered I/O (default), 0=unbuffered I/O */
+{
   int free_file;		/* file_table slot for new file */
 
   if ((free_file = find_free_file ()) != -1)	/* if file space is available */
     {				/* decide on name and initial length */
       create_file_name (file_table[free_file].name);
+      file_table[free_file].id = __sync_add_and_fetch (&file_ids, 1);
 
       file_table[free_file].size =
-	file_size_low + RND (file_size_high - file_size_low);
+	ALIGN_UP (next_file_size ());
+      if (file_table[free_file].size == 0)	/* FFSMark: 0 is a free slot */
+	file_table[free_file].size = io_align;
+      mark_file_used (free_file);	/* FFSMark */
 
-      if (buffered)
-	fp = fopen (file_table[free_file].name, "w");
+      if (planning)		/* FFSMark: I/O left to the timed loop */
+	plan_add (PLAN_CREATE, free_file, file_table[free_file].size, 0);
       else
-	fd = open (file_table[free_file].name, O_RDWR | O_CREAT | open_flags, 0644);
+	create_file_io (file_table[free_file].name,
+			file_table[free_file].size, file_table[free_file].id,
+			buffered);
+    }
+}
 
-      if (fp || fd != -1)
-	{
-	  if (buffered)
-	    {
-	      fwrite_blocks (fp, file_table[free_file].size);
-	      fclose (fp);
-	    }
-	  else
-	    {
-	      write_blocks (fd, file_table[free_file].size);
-	      close (fd);
-	    }
-	}
-      else
-	fprintf (stderr, "Error: cannot open '%s' for writing\n",
-		 file_table[free_file].name);
+/* FFSMark: the I/O part of delete_file, returns 0 on success */
+int
+delete_file_io (name, size, id)
+     char *name;		/* file to delete */
+     int size;			/* its length */
+     unsigned int id;		/* file id, for the operation trace */
+{
+  uint64_t start;
+
+  sync_forget (id);		/* FFSMark */
+  start = latency_now ();
+  if (remove (name))
+    {
+      op_done (LAT_DELETE, id, 0, 0, start, -errno);
+      fprintf (stderr, "Error: Cannot delete '%s'\n", name);
+      return (-1);
     }
+
+  op_done (LAT_DELETE, id, 0, size, start, 0);
+  files_deleted++;
+  return (0);
 }
 
 /* deletes specified file from disk and file_table */
@@ -973,175 +2323,1394 @@ delete_file (number)
 {
   if (file_table[number].size)
     {
-      if (remove (file_table[number].name))
-	fprintf (stderr, "Error: Cannot delete '%s'\n",
-		 file_table[number].name);
-      else
-	{			/* reset entry in file_table and update counter */
-	  file_table[number].size = 0;
-	  files_deleted++;
-	}
+      if (planning)		/* FFSMark: I/O left to the timed loop */
+	plan_add (PLAN_DELETE, number, file_table[number].size, 0);
+      else if (delete_file_io (file_table[number].name,
+			       file_table[number].size,
+			       file_table[number].id))
+	return;
+
+      /* reset entry in file_table and update counter */
+      file_table[number].size = 0;
+      mark_file_free (number);	/* FFSMark */
     }
 }
 
-/* reads entire specified file into temporary buffer */
+/* FFSMark: the I/O part of read_file - reads the 'size' bytes of 'name' */
 void
-read_file (number, buffered)
-     int number;		/* number of file to read (from file_table) */
+read_file_io (name, size, id, buffered)
+     char *name;		/* file to read */
+     int size;			/* its length */
+     unsigned int id;		/* file id, for the operation trace */
      int buffered;		/* 1=buffered I/O (default), 0=unbuffered I/O */
 {
   FILE *fp = NULL;
   int fd = -1;
   int i;
+  uint64_t start = latency_now ();
 
   if (buffered)
-    fp = fopen (file_table[number].name, "r");
+    fp = fopen (name, "r");
+  else if (io_engine == IO_ENGINE_URING)	/* whole access */
+    fd = uring_read_blocks (name, 0, size);
   else
-    fd = open (file_table[number].name, O_RDONLY | open_flags, 0644);
+    fd = ffsmark_core_open (name, O_RDONLY | open_flags, 0644);
 
   if (fp || fd != -1)
     {				/* read as many blocks as possible then read the remainder */
       if (buffered)
 	{
-	  for (i = file_table[number].size; i >= read_block_size;
-	       i -= read_block_size)
+	  for (i = size; i >= read_block_size; i -= read_block_size)
 	    fread (read_buffer, read_block_size, 1, fp);
 
 	  fread (read_buffer, i, 1, fp);
 
 	  fclose (fp);
 	}
-      else
+      else if (io_engine != IO_ENGINE_URING)
 	{
-	  for (i = file_table[number].size; i >= read_block_size;
-	       i -= read_block_size)
-	    read (fd, read_buffer, read_block_size);
+	  for (i = size; i >= read_block_size; i -= read_block_size)
+	    ffsmark_core_read (fd, read_buffer, read_block_size);
 
-	  read (fd, read_buffer, i);
+	  ffsmark_core_read (fd, read_buffer, i);
 
 	  close (fd);
 	}
 
       /* increment counters to record transaction */
-      bytes_read += file_table[number].size;
+      bytes_read += size;
       files_read++;
+      interval_add_bytes (size, 0);
+      op_done (LAT_READ, id, 0, size, start, 0);
     }
   else
-    fprintf (stderr, "Error: cannot open '%s' for reading\n",
-	     file_table[number].name);
+    {
+      op_done (LAT_READ, id, 0, 0, start, -errno);
+      fprintf (stderr, "Error: cannot open '%s' for reading\n", name);
+    }
 }
 
-/* appends random data to a chosen file up to the maximum configured length */
+/* reads entire specified file into temporary buffer */
 void
-append_file (number, buffered)
-     int number;		/* number of file (from file_table) to append date to */
+read_file (number, buffered)
+     int number;		/* number of file to read (from file_table) */
+     int buffered;		/* 1=buffered I/O (default), 0=unbuffered I/O */
+{
+  if (planning)			/* FFSMark: I/O left to the timed loop */
+    plan_add (PLAN_READ, number, file_table[number].size, 0);
+  else
+    read_file_io (file_table[number].name, file_table[number].size,
+		  file_table[number].id, buffered);
+}
+
+/* FFSMark: the I/O part of append_file - appends 'block' bytes to 'name',
+   'size' bytes long, returns 0 on success */
+int
+append_file_io (name, size, block, id, buffered)
+     char *name;		/* file to append to */
+     int size;			/* its length */
+     int block;			/* size of data to append */
+     unsigned int id;		/* file id, for the operation trace */
      int buffered;		/* 1=buffered I/O (default), 0=unbuffered I/O */
 {
   FILE *fp = NULL;
   int fd = -1;
-  int block;			/* size of data to append */
+  uint64_t start = latency_now ();
 
-  if (file_table[number].size < file_size_high)
+  if (buffered)
+    fp = fopen (name, "a");
+  else if (io_engine == IO_ENGINE_URING)	/* whole access */
+    fd = uring_write_blocks (name, O_RDWR | open_flags, size, block, id);
+  else
+    fd = ffsmark_core_open (name, O_RDWR | O_APPEND | open_flags, 0644);
+
+  if (fp || fd != -1)
     {
       if (buffered)
-	fp = fopen (file_table[number].name, "a");
-      else
-	fd = open (file_table[number].name, O_RDWR | O_APPEND | open_flags, 0644);
-
-      if ((fp || fd != -1) && file_table[number].size < file_size_high)
 	{
-	  block = RND (file_size_high - file_table[number].size) + 1;
-
-	  if (buffered)
-	    {
-	      fwrite_blocks (fp, block);
-	      fclose (fp);
-	    }
-	  else
-	    {
-	      write_blocks (fd, block);
-	      close (fd);
-	    }
+	  fwrite_blocks (fp, block, id, size);
+	  fflush (fp);		/* FFSMark */
+	  sync_written (fileno (fp), name, id);
+	  fclose (fp);
+	}
+      else if (io_engine != IO_ENGINE_URING)
+	{
+	  write_blocks (fd, block, id, size);
+	  sync_written (fd, name, id);	/* FFSMark */
+	  close (fd);
+	}
+      else
+	sync_written (-1, name, id);	/* FFSMark */
+
+      op_done (LAT_APPEND, id, size, block, start, 0);
+      files_appended++;
+      return (0);
+    }
+
+  op_done (LAT_APPEND, id, size, 0, start, -errno);
+  fprintf (stderr, "Error: cannot open '%s' for append\n", name);
+  return (-1);
+}
+
+/* appends random data to a chosen file up to the maximum configured length */
+void
+append_file (number, buffered)
+     int number;		/* number of file (from file_table) to append date to */
+     int buffered;		/* 1=buffered I/O (default), 0=unbuffered I/O */
+{
+  int block;			/* size of data to append */
+
+  if (file_table[number].size < file_size_high)
+    {
+      block = ALIGN_UP (next_append_size (file_table[number].size));
 
-	  file_table[number].size += block;
-	  files_appended++;
+      if (planning)		/* FFSMark: I/O left to the timed loop */
+	plan_add (PLAN_APPEND, number, block, file_table[number].size);
+      else if (append_file_io (file_table[number].name,
+			       file_table[number].size, block,
+			       file_table[number].id, buffered))
+	return;
+
+      file_table[number].size += block;
+    }
+}
+
+/* FFSMark: 'bytes' (aligned for direct I/O) at a random offset multiple of
+   'align' (rounded up to the direct I/O alignment) inside file_table slot
+   'number', the whole file if shorter */
+void
+partial_range (number, bytes, align, size, offset)
+     int number;
+     int bytes;
+     int align;
+     int *size;
+     int *offset;
+{
+  int length = file_table[number].size;
+
+  align = ALIGN_UP (align);
+  *size = ALIGN_UP (bytes);
+  if (*size > length)
+    *size = length;
+  *offset = RND ((length - *size) / align + 1) * align;
+}
+
+/* FFSMark: the I/O part of overwrite_file - writes 'size' bytes at 'offset'
+   of file 'name' in place, returns 0 on success */
+int
+overwrite_file_io (name, offset, size, id, buffered)
+     char *name;		/* file to overwrite */
+     int offset;
+     int size;
+     unsigned int id;		/* file id, for the operation trace */
+     int buffered;		/* 1=buffered I/O (default), 0=unbuffered I/O */
+{
+  FILE *fp = NULL;
+  int fd = -1;
+  uint64_t start = latency_now ();
+
+  if (buffered)
+    fp = fopen (name, "r+");
+  else if (io_engine == IO_ENGINE_URING)	/* whole access */
+    fd = uring_write_blocks (name, O_RDWR | open_flags, offset, size, id);
+  else
+    fd = ffsmark_core_open (name, O_RDWR | open_flags, 0644);
+
+  if (fp || fd != -1)
+    {
+      if (buffered)
+	{
+	  fseek (fp, offset, SEEK_SET);
+	  fwrite_blocks (fp, size, id, offset);
+	  fflush (fp);
+	  sync_written (fileno (fp), name, id);
+	  fclose (fp);
+	}
+      else if (io_engine != IO_ENGINE_URING)
+	{
+	  lseek (fd, offset, SEEK_SET);
+	  write_blocks (fd, size, id, offset);
+	  sync_written (fd, name, id);
+	  close (fd);
 	}
       else
-	fprintf (stderr, "Error: cannot open '%s' for append\n",
-		 file_table[number].name);
+	sync_written (-1, name, id);
+
+      op_done (LAT_OVERWRITE, id, offset, size, start, 0);
+      mix_done[MIX_OVERWRITE]++;
+      return (0);
+    }
+
+  op_done (LAT_OVERWRITE, id, offset, 0, start, -errno);
+  fprintf (stderr, "Error: cannot open '%s' for overwrite\n", name);
+  return (-1);
+}
+
+/* FFSMark: overwrites part of a file in place ('set overwrite') */
+void
+overwrite_file (number, buffered)
+     int number;		/* number of file (from file_table) */
+     int buffered;		/* 1=buffered I/O (default), 0=unbuffered I/O */
+{
+  int size, offset;
+
+  partial_range (number, overwrite_size, overwrite_align, &size, &offset);
+
+  if (planning)			/* I/O left to the timed loop */
+    plan_add (PLAN_OVERWRITE, number, size, offset);
+  else
+    overwrite_file_io (file_table[number].name, offset, size,
+		       file_table[number].id, buffered);
+}
+
+/* FFSMark: the I/O part of pread_file - reads 'size' bytes at 'offset' of
+   file 'name' */
+void
+pread_file_io (name, offset, size, id, buffered)
+     char *name;		/* file to read */
+     int offset;
+     int size;
+     unsigned int id;		/* file id, for the operation trace */
+     int buffered;		/* 1=buffered I/O (default), 0=unbuffered I/O */
+{
+  FILE *fp = NULL;
+  int fd = -1;
+  int i;
+  uint64_t start = latency_now ();
+
+  if (buffered)
+    fp = fopen (name, "r");
+  else if (io_engine == IO_ENGINE_URING)	/* whole access */
+    fd = uring_read_blocks (name, offset, size);
+  else
+    fd = ffsmark_core_open (name, O_RDONLY | open_flags, 0644);
+
+  if (fp || fd != -1)
+    {
+      if (buffered)
+	{
+	  fseek (fp, offset, SEEK_SET);
+	  for (i = size; i >= read_block_size; i -= read_block_size)
+	    fread (read_buffer, read_block_size, 1, fp);
+
+	  fread (read_buffer, i, 1, fp);
+
+	  fclose (fp);
+	}
+      else if (io_engine != IO_ENGINE_URING)
+	{
+	  lseek (fd, offset, SEEK_SET);
+	  for (i = size; i >= read_block_size; i -= read_block_size)
+	    ffsmark_core_read (fd, read_buffer, read_block_size);
+
+	  ffsmark_core_read (fd, read_buffer, i);
+
+	  close (fd);
+	}
+
+      bytes_read += size;
+      mix_done[MIX_PREAD]++;
+      interval_add_bytes (size, 0);
+      op_done (LAT_PREAD, id, offset, size, start, 0);
+    }
+  else
+    {
+      op_done (LAT_PREAD, id, offset, 0, start, -errno);
+      fprintf (stderr, "Error: cannot open '%s' for reading\n", name);
+    }
+}
+
+/* FFSMark: reads part of a file ('set pread') */
+void
+pread_file (number, buffered)
+     int number;		/* number of file (from file_table) */
+     int buffered;		/* 1=buffered I/O (default), 0=unbuffered I/O */
+{
+  int size, offset;
+
+  partial_range (number, pread_size, pread_align, &size, &offset);
+
+  if (planning)			/* I/O left to the timed loop */
+    plan_add (PLAN_PREAD, number, size, offset);
+  else
+    pread_file_io (file_table[number].name, offset, size,
+		   file_table[number].id, buffered);
+}
+
+/* FFSMark: the I/O part of meta_file - performs 'op' on file 'name' of id
+   'id', 'target' being its new name (rename, move) of id 'target_id' and
+   'size' its new length (truncate), returns 0 on success */
+int
+meta_file_io (op, name, id, target, target_id, size)
+     mix_op op;
+     char *name;		/* file operated on */
+     unsigned int id;
+     char *target;
+     unsigned int target_id;
+     int size;
+{
+  char path[MAX_LINE + 1];	/* link, or directory of the file */
+  char value[XATTR_SIZE];
+  struct stat st;
+  DIR *dir;
+  char *slash;
+  int result = 0, err;
+  uint64_t start = latency_now (), end;
+
+  switch (op)
+    {
+    case MIX_RENAME:
+    case MIX_MOVE:
+      result = rename (name, target);
+      break;
+
+    case MIX_STAT:
+      result = stat (name, &st);
+      break;
+
+    case MIX_READDIR:
+      strcpy (path, name);
+      if ((slash = strrchr (path, SEPARATOR[0])) != NULL)
+	slash[slash == path] = '\0';	/* keeps the root */
+      else
+	strcpy (path, ".");
+      if ((dir = opendir (path)) == NULL)
+	result = -1;
+      else
+	{
+	  while (readdir (dir) != NULL)
+	    ;
+	  closedir (dir);
+	}
+      break;
+
+    case MIX_LINK:
+    case MIX_SYMLINK:
+      sprintf (path, "%s.%s", name, (op == MIX_LINK) ? "l" : "s");
+      result = (op == MIX_LINK) ? link (name, path) : symlink (name, path);
+      break;
+
+    case MIX_TRUNCATE:
+      result = truncate (name, size);
+      break;
+
+    case MIX_SETXATTR:
+      result = setxattr (name, XATTR_NAME, file_source,
+			 (source_size < XATTR_SIZE) ? source_size :
+			 XATTR_SIZE, 0);
+      break;
+
+    case MIX_GETXATTR:		/* an attribute never set is not an error */
+      if (getxattr (name, XATTR_NAME, value, sizeof (value)) == -1
+	  && errno != ENODATA)
+	result = -1;
+      break;
+
+    default:
+      break;
+    }
+
+  /* the operations changing the files are traced for a replay */
+  end = latency_now ();
+  err = result ? errno : 0;
+  if (op == MIX_RENAME || op == MIX_MOVE)
+    optrace_add (OPTRACE_RENAME, id, 0, size, target_id, start, end, -err);
+  else if (op == MIX_TRUNCATE)
+    optrace_add (OPTRACE_TRUNCATE, id, size, 0, 0, start, end, -err);
+  errno = err;
+
+  if (result)
+    {
+      if ((op == MIX_SETXATTR || op == MIX_GETXATTR) && errno == ENOTSUP)
+	{
+	  if (!__sync_lock_test_and_set (&xattr_unsupported, 1))
+	    fprintf (stderr, "Error: no extended attributes on '%s'\n", name);
+	}
+      else
+	fprintf (stderr, "Error: cannot %s '%s': %s\n", mix_names[op], name,
+		 strerror (errno));
+      return (-1);
+    }
+
+  latency_record_ns (mix_latency[op], end - start);
+  mix_done[op]++;
+
+  /* links only live for the time of their creation */
+  if (op == MIX_LINK || op == MIX_SYMLINK)
+    unlink (path);
+
+  return (0);
+}
+
+/* FFSMark: metadata operation 'op' of the transaction mix on file_table
+   slot 'number' */
+void
+meta_file (op, number)
+     mix_op op;
+     int number;
+{
+  file_entry *file = &file_table[number];
+  char target[MAX_FILENAME + RENAME_SUFFIX + 1];
+  char *slash;
+  int size = file->size;
+  int length;
+  unsigned int id = file->id;
+
+  if (op == MIX_RENAME || op == MIX_MOVE)
+    {
+      /* a new name is a new file id, as the replay names files by id */
+      id = __sync_add_and_fetch (&file_ids, 1);
+      if (op == MIX_MOVE)
+	file_dir_name (target);
+      else
+	{
+	  strcpy (target, file->name);
+	  slash = strrchr (target, SEPARATOR[0]);
+	  *(slash ? slash + 1 : target) = '\0';
+	}
+      /* the file id keeps the name unique across the threads, the new
+         name must still fit in the file table */
+      length = strlen (target);
+      snprintf (target + length, sizeof (target) - length, "r%u.%d",
+		id, ++files_renamed);
+      if (strlen (target) > MAX_FILENAME)
+	{
+	  fprintf (stderr, "Error: cannot %s '%s': new name too long\n",
+		   mix_names[op], file->name);
+	  return;
+	}
+    }
+  else if (op == MIX_TRUNCATE)	/* stays aligned, and not empty */
+    {
+      size = (RND (file->size) / io_align) * io_align;
+      if (size == 0)
+	size = io_align;
+    }
+
+  if (planning)			/* I/O left to the timed loop */
+    {
+      plan_add (PLAN_META, number, size, 0);
+      planning->meta = op;
+      planning->target_id = id;
+      if (op == MIX_RENAME || op == MIX_MOVE)
+	planning->target = slot_names[number] = plan_name (target);
+    }
+  else if (meta_file_io (op, file->name, file->id, target, id, size))
+    return;
+
+  if (op == MIX_RENAME || op == MIX_MOVE)
+    strcpy (file->name, target);
+  file->id = id;
+  file->size = size;
+}
+
+/* finds and returns the offset of a file that is in use from the file_table */
+/* FFSMark: drawn from the live files of the calling thread's partition,
+   by the popularity rank of each file - a rank held by no file is drawn
+   again */
+int
+find_used_file ()		/* only called after files are created */
+{
+  int tries, slot;
+
+  for (tries = 0;
+       popularity.type != POPULARITY_UNIFORM && tries < POPULARITY_TRIES;
+       tries++)
+    {
+      slot = rank_slot[partition->base +
+		       ((popularity.type == POPULARITY_ZIPF) ?
+			zipf_next (&partition->zipf, partition->size) :
+			hotset_next (partition->size, popularity.hot_fraction,
+				     popularity.hot_probability))];
+      if (slot != -1)
+	return (slot);
+    }
+
+  return (live_files[partition->base + RND (partition->used)]);
+}
+
+/* reset global counters - done before each test run */
+void
+reset_counters ()
+{
+  files_created = 0;
+  files_deleted = 0;
+  files_read = 0;
+  files_appended = 0;
+  bytes_written = 0;
+  bytes_read = 0;
+  file_ids = 0;			/* FFSMark */
+  source_writes = 0;		/* FFSMark */
+  sync_every_pending = 0;	/* FFSMark */
+  memset (mix_done, 0, sizeof (mix_done));
+  files_renamed = 0;
+  xattr_unsupported = 0;
+}
+
+/* FFSMark: uniform double in (0,1] for Poisson inter-arrival times, from a
+   generator separate from genrand() so the workload stays the same */
+__thread uint64_t arrival_state;
+
+double
+arrival_random ()
+{
+  uint64_t x = (arrival_state += 0x9e3779b97f4a7c15ULL);	/* splitmix64 */
+
+  x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+  x ^= x >> 31;
+
+  return ((double) ((x >> 11) + 1) / 9007199254740992.0);
+}
+
+/* FFSMark: sleep until 'when' (latency_now () time base) */
+void
+sleep_until (when)
+     uint64_t when;
+{
+  struct timespec ts;
+
+  ts.tv_sec = when / 1000000000ULL;
+  ts.tv_nsec = when % 1000000000ULL;
+  while (clock_nanosleep (CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL))
+    ;
+}
+
+/* FFSMark: in open-loop mode, wait for the intended start time of the next
+   transaction and return it - closed-loop transactions start right away */
+uint64_t
+wait_transaction_start (next, share)
+     uint64_t *next;		/* intended start of the next transaction */
+     double share;		/* transactions per second for this thread */
+{
+  uint64_t intended, now;
+
+  now = latency_now ();
+  if (rate <= 0)
+    return (now);
+
+  if (*next == 0)
+    *next = now;
+  intended = *next;
+
+  if (rate_poisson)
+    *next += (uint64_t) (-log (arrival_random ()) * 1e9 / share);
+  else
+    *next += (uint64_t) (1e9 / share);
+
+  if (now < intended)
+    sleep_until (intended);
+
+  /* behind schedule: latency still counts from the intended start */
+  return (intended);
+}
+
+/* FFSMark: split the file table in one partition per worker thread */
+int
+init_partitions (count)
+     int count;			/* number of partitions */
+{
+  int total = simultaneous << 1;
+  int i, j;
+
+  if ((partitions =
+       (file_partition *) calloc (count, sizeof (file_partition))) == NULL
+      || (live_files = (int *) malloc (total * sizeof (int))) == NULL
+      || (live_position = (int *) malloc (total * sizeof (int))) == NULL
+      || (free_files = (int *) malloc (total * sizeof (int))) == NULL
+      || (rank_slot = (int *) malloc (total * sizeof (int))) == NULL
+      || (slot_rank = (int *) malloc (total * sizeof (int))) == NULL
+      || (free_ranks = (int *) malloc (total * sizeof (int))) == NULL)
+    {
+      fprintf (stderr, "Error: Failed to allocate %d file partitions\n",
+	       count);
+      return (-1);
+    }
+
+  for (i = 0; i < count; i++)
+    {
+      partitions[i].base = (int) (((long) total * i) / count);
+      partitions[i].size =
+	(int) (((long) total * (i + 1)) / count) - partitions[i].base;
+
+      zipf_init (&partitions[i].zipf, popularity.theta);
+
+      /* lowest slots on top of the stack, handed out first */
+      partitions[i].unused = partitions[i].size;
+      for (j = 0; j < partitions[i].size; j++)
+	free_files[partitions[i].base + j] =
+	  partitions[i].base + partitions[i].size - 1 - j;
+
+      /* FFSMark: no rank held yet */
+      for (j = 0; j < partitions[i].size; j++)
+	{
+	  rank_slot[partitions[i].base + j] = -1;
+	  free_ranks[partitions[i].base + j] = j;
+	}
+    }
+
+  partition = &partitions[0];
+  return (0);
+}
+
+/* FFSMark: first half of a transaction, drawn from the 'set mix' weights */
+void
+mix_transaction (buffered)
+     int buffered;		/* 1=buffered I/O (default), 0=unbuffered I/O */
+{
+  int draw = RND (mix_total);
+  int op;
+
+  for (op = 0; draw >= mix_weights[op]; op++)
+    draw -= mix_weights[op];
+
+  if (op == MIX_READ)
+    read_file (find_used_file (), buffered);
+  else if (op == MIX_APPEND)
+    append_file (find_used_file (), buffered);
+  else if (op == MIX_OVERWRITE)
+    overwrite_file (find_used_file (), buffered);
+  else if (op == MIX_PREAD)
+    pread_file (find_used_file (), buffered);
+  else
+    meta_file (op, find_used_file ());
+}
+
+/* FFSMark: one transaction, the body of the original loop */
+void
+perform_transaction (buffered)
+     int buffered;		/* 1=buffered I/O (default), 0=unbuffered I/O */
+{
+  if (mix_total)		/* FFSMark: weighted operation mix */
+    mix_transaction (buffered);
+  else if (bias_read != -1)	/* if read/append not locked out... */
+    {
+      if (RND (10) < bias_read)	/* read file */
+	read_file (find_used_file (), buffered);
+      else			/* append file */
+	append_file (find_used_file (), buffered);
+    }
+
+  if (bias_create != -1)	/* if create/delete not locked out... */
+    {
+      if (RND (10) < bias_create)	/* create file */
+	create_file (buffered);
+      else			/* delete file */
+	delete_file (find_used_file ());
+    }
+}
+
+/* FFSMark: I/O of a pre-generated operation */
+void
+run_plan_entry (entry, buffered)
+     plan_entry *entry;
+     int buffered;		/* 1=buffered I/O (default), 0=unbuffered I/O */
+{
+  switch (entry->op)
+    {
+    case PLAN_READ:
+      read_file_io (entry->name, entry->size, entry->id, buffered);
+      break;
+
+    case PLAN_APPEND:
+      append_file_io (entry->name, entry->offset, entry->size, entry->id,
+		      buffered);
+      break;
+
+    case PLAN_CREATE:
+      create_file_io (entry->name, entry->size, entry->id, buffered);
+      break;
+
+    case PLAN_DELETE:
+      delete_file_io (entry->name, entry->size, entry->id);
+      break;
+
+    case PLAN_OVERWRITE:
+      overwrite_file_io (entry->name, entry->offset, entry->size, entry->id,
+			 buffered);
+      break;
+
+    case PLAN_PREAD:
+      pread_file_io (entry->name, entry->offset, entry->size, entry->id,
+		     buffered);
+      break;
+
+    case PLAN_META:
+      meta_file_io (entry->meta, entry->name, entry->id, entry->target,
+		    entry->target_id, entry->size);
+      break;
+
+    case PLAN_NONE:
+      break;
+    }
+}
+
+/* FFSMark: pre-generate 'count' transactions of the calling thread's
+   partition, making the choices run_partition_transactions would make -
+   the file table ends up in its post-transactions state, I/O errors met
+   in the timed loop do not alter it */
+int
+plan_partition_transactions (count)
+     int count;			/* number of transactions to plan */
+{
+  int i;
+
+  if ((partition->plan =
+       (plan_entry *) calloc (2 * (size_t) count, sizeof (plan_entry)))
+      == NULL)
+    {
+      fprintf (stderr, "Error: Failed to allocate %d transactions\n",
+	       count);
+      return (-1);
+    }
+
+  for (i = partition->base; i < partition->base + partition->used; i++)
+    slot_names[live_files[i]] = plan_name (file_table[live_files[i]].name);
+
+  for (i = 0; i < count && partition->used; i++)
+    {
+      planning = &partition->plan[2 * i];
+      perform_transaction (0);
+    }
+
+  planning = NULL;
+  partition->planned = i;
+  return (0);
+}
+
+/* FFSMark: pre-generate the transactions of every partition, each with the
+   random stream its worker would use */
+int
+plan_transactions ()
+{
+  int p;
+
+  if ((slot_names =
+       (char **) calloc (simultaneous << 1, sizeof (char *))) == NULL)
+    {
+      fprintf (stderr, "Error: Failed to allocate table for %d files\n",
+	       simultaneous << 1);
+      return (-1);
+    }
+
+  for (p = 0; p < threads; p++)
+    {
+      partition = &partitions[p];
+      if (threads > 1)
+	{
+	  worker = p;
+	  sgenrand (seed + p + 1);
+	}
+
+      if (plan_partition_transactions ((int) (((long) transactions * (p + 1))
+					      / threads) -
+				       (int) (((long) transactions * p) /
+					      threads)) != 0)
+	return (-1);
+    }
+
+  worker = -1;
+  return (0);
+}
+
+/* FFSMark: release the pre-generated transactions */
+void
+free_plans ()
+{
+  plan_names *block;
+  int p;
+
+  for (p = 0; p < threads; p++)
+    {
+      free (partitions[p].plan);
+      partitions[p].plan = NULL;
+    }
+
+  while ((block = plan_name_blocks) != NULL)
+    {
+      plan_name_blocks = block->next;
+      free (block);
+    }
+
+  free (slot_names);
+  slot_names = NULL;
+}
+
+/* perform the configured number of file transactions
+   - a transaction consisted of either a read or append and either a
+     create or delete all chosen at random */
+/* FFSMark: works on the partition of the calling thread */
+int
+run_partition_transactions (count, buffered)
+     int count;			/* number of transactions to perform */
+     int buffered;		/* 1=buffered I/O (default), 0=unbuffered I/O */
+{
+  int percent;			/* one tenth of the specified transactions */
+  int i;
+  uint64_t start, next = 0;	/* FFSMark: transaction timeline */
+  double share = rate / threads;	/* FFSMark: offered load of this thread */
+
+  arrival_state = seed + worker + 1;
+
+  percent = count / 10;
+  for (i = 0; i < count; i++)
+    {
+      start = wait_transaction_start (&next, share);	/* FFSMark */
+
+      /* FFSMark: files_created == files_deleted */
+      if (partition->plan ? i >= partition->planned : partition->used == 0)
+	{
+	  printf ("out of files!\n");
+	  printf
+	    ("For this workload, either increase the number of files or\n");
+	  printf ("decrease the number of transactions.\n");
+	  break;
+	}
+
+      if (partition->plan)	/* FFSMark: pre-generated */
+	{
+	  run_plan_entry (&partition->plan[2 * i], buffered);
+	  run_plan_entry (&partition->plan[2 * i + 1], buffered);
+	}
+      else
+	perform_transaction (buffered);
+
+      latency_record (LAT_TRANSACTION, start);	/* FFSMark */
+
+      /* if another tenth of the work is done... (FFSMark: first worker) */
+      if (worker <= 0 && percent && (i % percent) == 0)
+	{
+	  putchar ('.');	/* print progress indicator */
+	  fflush (stdout);
+	}
+    }
+
+  sync_finish ();		/* FFSMark: last group commit batch */
+  return (count - i);
+}
+
+/* FFSMark: state handed over to a transaction worker thread */
+typedef struct
+{
+  pthread_t thread;
+  int id;			/* worker id, also its partition */
+  int count;			/* number of transactions to perform */
+  int buffered;			/* 1=buffered I/O (default), 0=unbuffered I/O */
+  int incomplete;		/* transactions left undone */
+  int files_created, files_deleted, files_read, files_appended;
+  float bytes_written, bytes_read;
+  int mix_done[MIX_OP_NUM];
+} transaction_worker;
+
+/* FFSMark: worker thread body - own partition, own random stream */
+void *
+transaction_worker_main (arg)
+     void *arg;
+{
+  transaction_worker *w = (transaction_worker *) arg;
+
+  worker = w->id;
+  partition = &partitions[w->id];
+  sgenrand (seed + w->id + 1);
+
+  if (latency_thread_init () != 0)
+    {
+      w->incomplete = w->count;
+      return (NULL);
+    }
+  latency_set_phase (LAT_PHASE_TRANSACTIONS);
+
+  if (!w->buffered && io_engine == IO_ENGINE_URING
+      && uring_engine_setup (io_queue_depth) != 0)
+    {
+      w->incomplete = w->count;
+      return (NULL);
+    }
+
+  if ((read_buffer = alloc_io_buffer (read_block_size)) == NULL
+      || (content_unique
+	  && (write_buffer = alloc_io_buffer (source_size)) == NULL))
+    {
+      fprintf (stderr, "Error: worker %d cannot allocate I/O buffers\n",
+	       w->id);
+      free (read_buffer);
+      w->incomplete = w->count;
+      return (NULL);
+    }
+
+  w->incomplete = run_partition_transactions (w->count, w->buffered);
+
+  w->files_created = files_created;
+  w->files_deleted = files_deleted;
+  w->files_read = files_read;
+  w->files_appended = files_appended;
+  w->bytes_written = bytes_written;
+  w->bytes_read = bytes_read;
+  memcpy (w->mix_done, mix_done, sizeof (mix_done));
+
+  free (read_buffer);
+  free (write_buffer);
+  uring_engine_teardown ();
+  latency_thread_merge ();
+  return (NULL);
+}
+
+/* perform the configured number of transactions, either from the calling
+   thread or spread over 'threads' workers (FFSMark) */
+int
+run_transactions (buffered)
+     int buffered;		/* 1=buffered I/O (default), 0=unbuffered I/O */
+{
+  transaction_worker *workers;
+  int incomplete = 0;
+  int started;
+  int i;
+  int op;			/* FFSMark: mix operation iterator */
+
+  if (threads <= 1)
+    {
+      partition = &partitions[0];
+      return (run_partition_transactions (transactions, buffered));
+    }
+
+  if ((workers = (transaction_worker *) calloc (threads,
+						 sizeof (transaction_worker)))
+      == NULL)
+    {
+      fprintf (stderr, "Error: Failed to allocate %d workers\n", threads);
+      return (transactions);
+    }
+
+  for (started = 0; started < threads; started++)
+    {
+      workers[started].id = started;
+      workers[started].buffered = buffered;
+      workers[started].count =
+	(int) (((long) transactions * (started + 1)) / threads) -
+	(int) (((long) transactions * started) / threads);
+
+      if (pthread_create (&workers[started].thread, NULL,
+			  transaction_worker_main, &workers[started]))
+	{
+	  fprintf (stderr, "Error: cannot start worker %d\n", started);
+	  break;
+	}
+    }
+
+  /* wait for the workers and merge their counters into ours */
+  for (i = 0; i < started; i++)
+    {
+      pthread_join (workers[i].thread, NULL);
+
+      incomplete += workers[i].incomplete;
+      files_created += workers[i].files_created;
+      files_deleted += workers[i].files_deleted;
+      files_read += workers[i].files_read;
+      files_appended += workers[i].files_appended;
+      bytes_written += workers[i].bytes_written;
+      bytes_read += workers[i].bytes_read;
+      for (op = 0; op < MIX_OP_NUM; op++)	/* FFSMark */
+	mix_done[op] += workers[i].mix_done[op];
+    }
+
+  for (; i < threads; i++)
+    incomplete += workers[i].count;
+
+  free (workers);
+  return (incomplete);
+}
+
+/* FFSMark: trace replay - the operations of replay_path are performed by the
+   main thread on files named after their trace id, in trace order */
+typedef struct
+{
+  int64_t size;			/* current size, -1 if the file is absent */
+  int fd;			/* descriptor kept between OPEN and CLOSE */
+  int opens;			/* number of OPEN records not closed yet */
+} replay_file;
+
+replay_file *replay_files;	/* replayed files, indexed by trace id */
+unsigned int replay_capacity;	/* number of entries in replay_files */
+
+/* FFSMark: latency class and trace operation of each trace record */
+latency_op replay_ops[OPTRACE_OP_NUM] = { LAT_CREATE, LAT_READ, LAT_APPEND,
+  LAT_DELETE, LAT_OPEN, LAT_CLOSE, LAT_WRITE, LAT_SYNC, LAT_RENAME,
+  LAT_TRUNCATE
+};
+
+/* FFSMark: builds the name of replayed file 'id' */
+void
+replay_file_name (dest, id)
+     char *dest;
+     unsigned int id;
+{
+  char conversion[MAX_LINE + 1];
+
+  *dest = '\0';
+  if (file_system_count)
+    {
+      strcat (dest, location_index[id % file_system_weight]);
+      strcat (dest, SEPARATOR);
+    }
+
+  if (subdirectories > 1)
+    {
+      sprintf (conversion, "s%u%s", id % subdirectories, SEPARATOR);
+      strcat (dest, conversion);
+    }
+
+  sprintf (conversion, "r%u", id);
+  strcat (dest, conversion);
+}
+
+/* FFSMark: make room for file 'id' in replay_files */
+int
+replay_reserve (id)
+     unsigned int id;
+{
+  unsigned int capacity = replay_capacity ? replay_capacity : 1024;
+  unsigned int i;
+  replay_file *files;
+
+  if (id < replay_capacity)
+    return (0);
+
+  if (id >= (1U << 28))
+    {
+      fprintf (stderr, "Error: trace file id %u is too large\n", id);
+      return (-1);
+    }
+
+  while (capacity <= id)
+    capacity <<= 1;
+
+  if ((files = (replay_file *) realloc (replay_files,
+					capacity * sizeof (replay_file)))
+      == NULL)
+    {
+      fprintf (stderr, "Error: Failed to allocate table for %u files\n",
+	       capacity);
+      return (-1);
+    }
+
+  for (i = replay_capacity; i < capacity; i++)
+    {
+      files[i].size = -1;
+      files[i].fd = -1;
+      files[i].opens = 0;
+    }
+  replay_files = files;
+  replay_capacity = capacity;
+
+  return (0);
+}
+
+/* FFSMark: write 'size' bytes to 'fd', cycling over the junk buffer since
+   trace sizes are not bounded by 'set size' */
+void
+replay_write (fd, size, id, offset)
+     int fd;
+     unsigned int size;
+     unsigned int id;		/* file id, for unique content */
+     uint64_t offset;		/* offset of the write in the file */
+{
+  int block = (write_block_size < source_size) ? write_block_size :
+    source_size;
+  unsigned int done;
+  int chunk;
+
+  /* cycle over file_source, or draw each block with 'set content unique'
+     or 'set compressibility' */
+  for (done = 0; done < size; done += chunk)
+    {
+      chunk = (size - done < (unsigned int) block) ? (int) (size - done)
+	: block;
+      ffsmark_core_write (fd, (content_unique || compressibility > 0) ?
+			  write_source (chunk, id, offset + done) :
+			  file_source + ((done / block) % (source_size / block))
+			  * block, chunk);
+    }
+
+  bytes_written += size;
+  interval_add_bytes (0, size);
+}
+
+/* FFSMark: read 'size' bytes of 'fd' */
+void
+replay_read (fd, size)
+     int fd;
+     unsigned int size;
+{
+  unsigned int done;
+  int chunk;
+
+  for (done = 0; done < size; done += chunk)
+    {
+      chunk = (size - done < (unsigned int) read_block_size) ?
+	(int) (size - done) : read_block_size;
+      ffsmark_core_read (fd, read_buffer, chunk);
+    }
+
+  bytes_read += size;
+  interval_add_bytes (size, 0);
+}
+
+/* FFSMark: perform one trace record, return 0 or -errno */
+int
+replay_record (rec)
+     optrace_record *rec;
+{
+  char name[MAX_LINE + 1], target[MAX_LINE + 1];
+  replay_file *file;
+  int flags = O_RDWR | open_flags;
+  int fd;
+
+  if (replay_reserve (rec->file_id) != 0
+      || (rec->op == OPTRACE_RENAME && replay_reserve (rec->aux) != 0))
+    return (-ENOMEM);
+  file = &replay_files[rec->file_id];
+  replay_file_name (name, rec->file_id);
+
+  switch (rec->op)
+    {
+    case OPTRACE_CREATE:
+      flags |= O_CREAT | O_TRUNC;
+      break;
+
+    case OPTRACE_OPEN:
+      if (rec->aux & OPTRACE_OPEN_CREATE)
+	flags |= O_CREAT;
+      if (rec->aux & OPTRACE_OPEN_TRUNCATE)
+	flags |= O_TRUNC;
+      break;
+
+    case OPTRACE_READ:
+      flags = O_RDONLY | open_flags;
+      break;
+
+    case OPTRACE_DELETE:
+      if (remove (name))
+	return (-errno);
+      if (file->fd != -1)	/* deleted while open */
+	close (file->fd);
+      file->size = -1;
+      file->fd = -1;
+      file->opens = 0;
+      files_deleted++;
+      return (0);
+
+    case OPTRACE_RENAME:
+      if (rec->aux == rec->file_id)
+	return (0);
+      replay_file_name (target, rec->aux);
+      if (rename (name, target))
+	return (-errno);
+      if (replay_files[rec->aux].fd != -1)	/* replaced while open */
+	close (replay_files[rec->aux].fd);
+      replay_files[rec->aux] = *file;
+      file->size = -1;
+      file->fd = -1;
+      file->opens = 0;
+      return (0);
+
+    case OPTRACE_TRUNCATE:
+      if (file->fd != -1 ? ftruncate (file->fd, (off_t) rec->offset)
+	  : truncate (name, (off_t) rec->offset))
+	return (-errno);
+      file->size = rec->offset;
+      return (0);
+
+    case OPTRACE_CLOSE:
+      if (file->opens > 0 && --file->opens == 0)
+	{
+	  close (file->fd);
+	  file->fd = -1;
+	}
+      return (0);
+    }
+
+  /* the descriptor of an open file is reused, otherwise the file is only
+     open for this operation as in the generated transactions */
+  if ((fd = file->fd) == -1
+      && (fd = ffsmark_core_open (name, flags, 0644)) == -1)
+    return (-errno);
+
+  switch (rec->op)
+    {
+    case OPTRACE_CREATE:
+      replay_write (fd, rec->size, rec->file_id, 0);
+      file->size = rec->size;
+      files_created++;
+      break;
+
+    case OPTRACE_OPEN:
+      if (file->size < 0)
+	files_created++;
+      if (file->size < 0 || (rec->aux & OPTRACE_OPEN_TRUNCATE))
+	file->size = 0;
+      file->fd = fd;
+      file->opens++;
+      return (0);
+
+    case OPTRACE_READ:
+      lseek (fd, (off_t) rec->offset, SEEK_SET);
+      replay_read (fd, rec->size);
+      files_read++;
+      break;
+
+    case OPTRACE_APPEND:
+    case OPTRACE_WRITE:	/* counted as appends in the report */
+      lseek (fd, (off_t) rec->offset, SEEK_SET);
+      replay_write (fd, rec->size, rec->file_id, rec->offset);
+      if ((int64_t) (rec->offset + rec->size) > file->size)
+	file->size = rec->offset + rec->size;
+      files_appended++;
+      break;
+
+    case OPTRACE_FSYNC:
+      if ((rec->aux & OPTRACE_FSYNC_FS) ? syncfs (fd)
+	  : (rec->aux & OPTRACE_FSYNC_DATA) ? fdatasync (fd) : fsync (fd))
+	return (-errno);
+      break;
     }
+
+  if (fd != file->fd)
+    close (fd);
+
+  return (0);
 }
 
-/* finds and returns the offset of a file that is in use from the file_table */
-int
-find_used_file ()		/* only called after files are created */
+/* FFSMark: account for a replayed record, re-recorded as is when
+   'set record' is active */
+void
+replay_done (rec, start, result)
+     optrace_record *rec;
+     uint64_t start;
+     int result;
 {
-  int used_file;
+  uint64_t end = latency_now ();
 
-  while (file_table[used_file = RND (simultaneous << 1)].size == 0)
-    ;
+  if (!result)
+    latency_record_ns (replay_ops[rec->op], end - start);
 
-  return (used_file);
+  optrace_add (rec->op, rec->file_id, rec->offset, rec->size, rec->aux,
+	       start, end, result);
 }
 
-/* reset global counters - done before each test run */
-void
-reset_counters ()
+/* FFSMark: preload records come first in a trace and stand for the files
+   which existed before it was captured - they are created along with the
+   initial files */
+int
+replay_preload ()
 {
-  files_created = 0;
-  files_deleted = 0;
-  files_read = 0;
-  files_appended = 0;
-  bytes_written = 0;
-  bytes_read = 0;
+  optrace_reader reader;
+  optrace_record rec;
+  uint64_t start;
+  int result;
+
+  if (optrace_reader_open (&reader, replay_path) != 0)
+    return (-1);
+
+  while (optrace_reader_next (&reader, &rec) > 0
+	 && rec.op == OPTRACE_CREATE && rec.aux == OPTRACE_CREATE_PRELOAD)
+    {
+      start = latency_now ();
+      if ((result = replay_record (&rec)) != 0)
+	fprintf (stderr, "Error: cannot preload file %u (%s)\n",
+		 rec.file_id, strerror (-result));
+      replay_done (&rec, start, result);
+    }
+
+  optrace_reader_close (&reader);
+  return (0);
 }
 
-/* perform the configured number of file transactions
-   - a transaction consisted of either a read or append and either a
-     create or delete all chosen at random */
+/* FFSMark: replay the trace in place of the transactions, the number of
+   replayed records is stored in 'replayed' - returns -1 if the trace cannot
+   be read */
 int
-run_transactions (buffered)
-     int buffered;		/* 1=buffered I/O (default), 0=unbuffered I/O */
+run_replay (replayed)
+     int *replayed;
 {
-  int percent;			/* one tenth of the specified transactions */
-  int i;
+  optrace_reader reader;
+  optrace_record rec;
+  uint64_t base = 0, first, start, intended;
+  int status, result;
 
-  percent = transactions / 10;
-  for (i = 0; i < transactions; i++)
+  *replayed = 0;
+  if (optrace_reader_open (&reader, replay_path) != 0)
+    return (-1);
+
+  /* the trace timeline starts at the header's base rather than the first
+     record, which can come after an idle start */
+  first = reader.header.monotonic_base;
+
+  while ((status = optrace_reader_next (&reader, &rec)) > 0)
     {
-      if (files_created == files_deleted)
-	{
-	  printf ("out of files!\n");
-	  printf
-	    ("For this workload, either increase the number of files or\n");
-	  printf ("decrease the number of transactions.\n");
-	  break;
+      if (rec.result || rec.op >= OPTRACE_OP_NUM
+	  || (rec.op == OPTRACE_CREATE && rec.aux == OPTRACE_CREATE_PRELOAD))
+	continue;		/* failed when recorded, unknown or preloaded */
+
+      start = latency_now ();
+      if (replay_timed)
+	{			/* keep the trace spacing, measuring latency
+				   from the intended start like 'set rate' */
+	  if (!base)
+	    base = start;
+
+	  intended = base + ((rec.start > first) ? rec.start - first : 0);
+	  if (intended > start)
+	    sleep_until (intended);
+	  start = intended;
 	}
 
-      if (bias_read != -1)	/* if read/append not locked out... */
-	{
-	  if (RND (10) < bias_read)	/* read file */
-	    read_file (find_used_file (), buffered);
-	  else			/* append file */
-	    append_file (find_used_file (), buffered);
-	}
+      if ((result = replay_record (&rec)) != 0)
+	fprintf (stderr, "Error: cannot replay %s of file %u (%s)\n",
+		 optrace_op_name (rec.op), rec.file_id, strerror (-result));
 
-      if (bias_create != -1)	/* if create/delete not locked out... */
-	{
-	  if (RND (10) < bias_create)	/* create file */
-	    create_file (buffered);
-	  else			/* delete file */
-	    delete_file (find_used_file ());
-	}
+      replay_done (&rec, start, result);
+      (*replayed)++;
+    }
+
+  if (status < 0)
+    fprintf (stderr, "Error: truncated record in trace '%s'\n",
+	     replay_path);
+
+  optrace_reader_close (&reader);
+  return (0);
+}
 
-      if ((i % percent) == 0)	/* if another tenth of the work is done... */
+/* FFSMark: close and delete the replayed files still present */
+void
+delete_replay_files ()
+{
+  optrace_record rec;
+  uint64_t start;
+  int result;
+
+  memset (&rec, 0, sizeof (rec));
+  rec.op = OPTRACE_DELETE;
+
+  for (rec.file_id = 0; rec.file_id < replay_capacity; rec.file_id++)
+    {
+      if (replay_files[rec.file_id].fd != -1)
+	close (replay_files[rec.file_id].fd);
+      replay_files[rec.file_id].fd = -1;
+
+      if (replay_files[rec.file_id].size >= 0)
 	{
-	  putchar ('.');	/* print progress indicator */
-	  fflush (stdout);
+	  start = latency_now ();
+	  rec.size = replay_files[rec.file_id].size;
+	  if ((result = replay_record (&rec)) != 0)
+	    fprintf (stderr, "Error: Cannot delete replayed file %u\n",
+		     rec.file_id);
+	  replay_done (&rec, start, result);
 	}
     }
 
-  return (transactions - i);
+  free (replay_files);
+  replay_files = NULL;
+  replay_capacity = 0;
 }
 
 char **
@@ -1223,35 +3792,110 @@ delete_subdirectories (dir_list, base_dir, subdirs)
     }
 }
 
-/* CLI callback for 'run' - benchmark execution loop */
-int
-cli_run (param)			/* none */
-     char *param;		/* unused */
+/* FFSMark: metrics of a measured iteration, for the run summary */
+void
+collect_results ()
+{
+  struct timeval res;
+  double elapsed, t_elapsed;
+  char name[RESULTS_NAME_LEN];
+  int i;
+
+  timersub (&ffsmark_end, &ffsmark_start, &res);
+  elapsed = res.tv_sec + (res.tv_usec / 1000000.0);
+  timersub (&ffsmark_transaction_end, &ffsmark_transaction_start, &res);
+  t_elapsed = res.tv_sec + (res.tv_usec / 1000000.0);
+
+  results_add ("seconds total", elapsed);
+  results_add ("seconds of transactions", t_elapsed);
+  results_add ("transactions per second", transactions / t_elapsed);
+  results_add ("files created per second", files_created / elapsed);
+  results_add ("files read per second", files_read / t_elapsed);
+  results_add ("files appended per second", files_appended / t_elapsed);
+  results_add ("files deleted per second", files_deleted / elapsed);
+  results_add ("MB read per second", bytes_read / elapsed / MEGABYTE);
+  results_add ("MB written per second", bytes_written / elapsed / MEGABYTE);
+  for (i = MIX_OVERWRITE; mix_total && i < MIX_OP_NUM; i++)	/* FFSMark */
+    if (mix_weights[i])
+      {
+	snprintf (name, sizeof (name), "%s per second", mix_names[i]);
+	results_add (name, mix_done[i] / t_elapsed);
+      }
+  latency_results ();
+  ffsmark_core_results ();
+}
+
+/* benchmark execution loop - FFSMark: one iteration of 'run', reported
+   and added to the summary when 'measured' */
+void
+run_iteration (param, measured)
+     char *param;		/* optional: name of output file */
+     int measured;
 {
   time_t start_time, t_start_time, t_end_time, end_time;	/* elapsed timers */
   int delete_base;		/* snapshot of deleted files counter */
   FILE *fp = NULL;		/* file descriptor for directing output */
   int incomplete;
   int i;			/* generic iterator */
+  int p;			/* FFSMark: partition iterator */
+  int saved_read_block_size = read_block_size;	/* FFSMark */
+  int saved_write_block_size = write_block_size;
+  int saved_transactions = transactions;	/* FFSMark */
 
   reset_counters ();		/* reset counters before each run */
 
+  /* FFSMark: per operation latencies */
+  latency_reset ();
+  if (latency_thread_init () != 0)
+    exit (EXIT_FAILURE);
+  latency_set_phase (LAT_PHASE_CREATION);
+
   sgenrand (seed);		/* initialize random number generator */
 
+  /* FFSMark: direct I/O needs aligned buffers, block sizes and offsets */
+  io_align = 1;
+  if (!buffered_io && (open_flags & O_DIRECT))
+    {
+      io_align = ffsmark_direct_alignment (file_systems ?
+					   file_systems->system.name : ".");
+      read_block_size = ALIGN_UP (read_block_size);
+      write_block_size = ALIGN_UP (write_block_size);
+      printf ("Direct I/O aligned on %d bytes (read=%d, write=%d)\n",
+	      io_align, read_block_size, write_block_size);
+    }
+
+  /* FFSMark: size distributions for this run's bounds */
+  if (size_distrib_build (&create_sizes, file_size_low, file_size_high)
+      || size_distrib_build (&append_sizes, 1, file_size_high))
+    exit (EXIT_FAILURE);
+
   /* allocate file space and fill with junk */
-  file_source = initialize_file_source (file_size_high << 1);
+  source_size = ALIGN_UP (file_size_high << 1);	/* FFSMark */
+  if (compressibility > 0 && source_size < COMPRESSIBLE_SOURCE)
+    source_size = COMPRESSIBLE_SOURCE;	/* room for distinct contents */
+  file_source = initialize_file_source (source_size);
 
   /* allocate read buffer */
-  read_buffer = (char *) malloc (read_block_size);
+  read_buffer = alloc_io_buffer (read_block_size);
+  if (content_unique)		/* FFSMark */
+    write_buffer = alloc_io_buffer (source_size);
 
   /* allocate table of files at 2 x simultaneous files */
-  file_allocated = 0;
   if ((file_table =
        (file_entry *) calloc (simultaneous << 1,
 			      sizeof (file_entry))) == NULL)
     fprintf (stderr, "Error: Failed to allocate table for %d files\n",
 	     simultaneous << 1);
 
+  /* FFSMark */
+  if (init_partitions (threads) != 0)
+    exit (EXIT_FAILURE);
+
+  /* FFSMark */
+  if (!buffered_io && io_engine == IO_ENGINE_URING
+      && uring_engine_setup (io_queue_depth) != 0)
+    exit (EXIT_FAILURE);
+
   if (file_system_count > 0)
     location_index = build_location_index (file_systems, file_system_weight);
 
@@ -1287,12 +3931,26 @@ cli_run (param)			/* none */
   /* create files in specified directory until simultaneous number */
   printf ("Creating files...");
   fflush (stdout);
-  for (i = 0; i < simultaneous; i++)
-    create_file (buffered_io);
+  /* FFSMark: the initial pool is spread evenly over the partitions */
+  for (p = 0; p < threads; p++)
+    {
+      partition = &partitions[p];
+      for (i = (int) (((long) simultaneous * p) / threads);
+	   i < (int) (((long) simultaneous * (p + 1)) / threads); i++)
+	create_file (buffered_io);
+    }
+  sync_finish ();		/* FFSMark: last group commit batch */
+  if (replay_path[0])		/* FFSMark: files the trace expects */
+    replay_preload ();
   printf ("Done\n");
 
+  /* FFSMark: decide every transaction before the timed window */
+  if (pregenerate && !replay_path[0] && plan_transactions () != 0)
+    exit (EXIT_FAILURE);
+
   printf ("Performing transactions");
   fflush (stdout);
+  latency_set_phase (LAT_PHASE_TRANSACTIONS);	/* FFSMark */
 
   /* FFSMark */
   if (ffsmark_hooks_pre_transactions ())
@@ -1307,7 +3965,10 @@ cli_run (param)			/* none */
       exit (EXIT_FAILURE);
     }
 
-  incomplete = run_transactions (buffered_io);
+  if (replay_path[0])		/* FFSMark: trace replay */
+    incomplete = (run_replay (&transactions) != 0);
+  else
+    incomplete = run_transactions (buffered_io);
 
   /* FFSMark */
   if (gettimeofday (&ffsmark_transaction_end, NULL))
@@ -1328,13 +3989,20 @@ cli_run (param)			/* none */
   /* delete remaining files */
   printf ("Deleting files...");
   fflush (stdout);
+  latency_set_phase (LAT_PHASE_DELETION);	/* FFSMark */
   delete_base = files_deleted;
-  for (i = 0; i < simultaneous << 1; i++)
-    delete_file (i);
+  for (p = 0; p < threads; p++)	/* FFSMark: partition by partition */
+    {
+      partition = &partitions[p];
+      for (i = partition->base; i < partition->base + partition->size; i++)
+	delete_file (i);
+    }
+  delete_replay_files ();	/* FFSMark */
   printf ("Done\n");
 
   /* print end time and difference, transaction numbers */
   time (&end_time);
+  latency_thread_merge ();	/* FFSMark */
 
   /* FFSMark */
   if (gettimeofday (&ffsmark_end, NULL))
@@ -1375,19 +4043,79 @@ cli_run (param)			/* none */
   if (!fp)
     fp = stdout;
 
-  if (!incomplete)
-    reports[report] (fp, end_time, start_time, t_end_time, t_start_time,
-		     files_deleted - delete_base);
+  if (!incomplete && measured)
+    {
+      results_begin_iteration ();	/* FFSMark */
+      reports[report] (fp, end_time, start_time, t_end_time, t_start_time,
+		       files_deleted - delete_base);
+      collect_results ();
+    }
 
   if (param && fp != stdout)
     fclose (fp);
 
   /* free resources allocated for this run */
+  free_plans ();		/* FFSMark */
+  free (partitions);
+  free (live_files);
+  free (live_position);
+  free (free_files);
+  free (rank_slot);
+  free (slot_rank);
+  free (free_ranks);
+  partitions = NULL;
+  partition = NULL;
   free (file_table);
   free (read_buffer);
+  free (write_buffer);		/* FFSMark */
+  write_buffer = NULL;
   free (file_source);
+  uring_engine_teardown ();	/* FFSMark */
+  size_distrib_free (&create_sizes);
+  size_distrib_free (&append_sizes);
+
+  /* FFSMark: restore the configured block sizes */
+  read_block_size = saved_read_block_size;
+  write_block_size = saved_write_block_size;
+  transactions = saved_transactions;
+  io_align = 1;
+}
 
-  return (1);			/* return 1 unless exit requested, then return 0 */
+/* CLI callback for 'run' - FFSMark: 'set warmup' then 'set repeat'
+   iterations, summarized when there are several measured ones */
+int
+cli_run (param)
+     char *param;		/* optional: name of output file */
+{
+  int saved_seed = seed;
+  int i;
+  FILE *fp = NULL;
+
+  results_reset ();
+  for (i = 0; i < warmup + repeat; i++)
+    {
+      if (reseed)
+	seed = saved_seed + i;
+      if (warmup + repeat > 1)
+	printf ("\n%s iteration %d/%d (seed %d)\n",
+		(i < warmup) ? "Warmup" : "Measured",
+		(i < warmup) ? i + 1 : i - warmup + 1,
+		(i < warmup) ? warmup : repeat, seed);
+      run_iteration (param, i >= warmup);
+    }
+  seed = saved_seed;
+
+  if (results_iterations () > 1)
+    {
+      if (param && (fp = fopen (param, "a")) == NULL)
+	fprintf (stderr, "Error: Cannot direct output to file '%s'\n",
+		 param);
+      results_summary (fp ? fp : stdout);
+      if (fp)
+	fclose (fp);
+    }
+
+  return (1);
 }
 
 /* CLI callback for 'show' - print values of configuration variables */
@@ -1398,6 +4126,7 @@ cli_show (param)
   char current_dir[MAX_LINE + 1];	/* buffer containing working directory */
   file_system *traverse;
   FILE *fp = NULL;		/* file descriptor for directing output */
+  int i;			/* FFSMark: mix operation iterator */
 
   if (param)
     if ((fp = fopen (param, "a")) == NULL)
@@ -1434,11 +4163,69 @@ cli_show (param)
   fprintf (fp, "write=%s\n", scale (write_block_size));
   fprintf (fp, "Biases are: read/append=%d, create/delete=%d\n", bias_read,
 	   bias_create);
+  if (mix_total)		/* FFSMark */
+    {
+      fprintf (fp, "Read/append replaced by the mix:");
+      for (i = 0; i < MIX_OP_NUM; i++)
+	if (mix_weights[i])
+	  fprintf (fp, " %s=%d", mix_names[i], mix_weights[i]);
+      fprintf (fp, "\n");
+      if (mix_weights[MIX_OVERWRITE])
+	fprintf (fp, "Overwrites of %d bytes, offsets aligned on %d\n",
+		 overwrite_size, overwrite_align);
+      if (mix_weights[MIX_PREAD])
+	fprintf (fp, "Partial reads of %d bytes, offsets aligned on %d\n",
+		 pread_size, pread_align);
+    }
   fprintf (fp, "%ssing Unix buffered file I/O\n",
 	   buffered_io ? "U" : "Not u");
   fprintf (fp, "Random number generator seed is %d\n", seed);
-
-  fprintf (fp, "Report format is %s.\n", report ? "terse" : "verbose");
+  fprintf (fp, "Transactions performed by %d thread%s\n", threads,
+	   (threads > 1) ? "s" : "");	/* FFSMark */
+  if (warmup + repeat > 1)
+    fprintf (fp, "Runs of %d warmup and %d measured iteration%s (%s)\n",
+	     warmup, repeat, (repeat > 1) ? "s" : "",
+	     reseed ? "seed incremented every iteration" : "same seed");
+  size_distrib_show (fp, "Initial file", &create_sizes);	/* FFSMark */
+  size_distrib_show (fp, "Append", &append_sizes);
+  popularity_show (fp, &popularity);
+  if (rate > 0)			/* FFSMark */
+    fprintf (fp, "Open-loop offered load: %.2lf transactions per second "
+	     "(%s arrivals)\n", rate, rate_poisson ? "Poisson" : "fixed");
+  else
+    fprintf (fp, "Closed-loop transactions\n");
+  if (compressibility > 0)	/* FFSMark */
+    fprintf (fp, "Files hold binary data compressible %.2lf:1",
+	     compressibility);
+  else
+    fprintf (fp, "Files hold %s data",
+	     source_binary ? "binary" : "printable");	/* FFSMark */
+  if (content_unique)
+    fprintf (fp, ", unique per file and offset (%.0lf%% duplicate "
+	     "4KiB blocks)\n", dedupe * 100);
+  else
+    fprintf (fp, ", copied from a shared buffer\n");
+  if (pregenerate)
+    fprintf (fp, "Transactions pre-generated before the timed phase\n");
+  if (replay_path[0])
+    fprintf (fp, "Transactions replaced by the replay of %s (%s, by the "
+	     "main thread with unbuffered I/O)\n", replay_path,
+	     replay_timed ? "trace timing" : "as fast as possible");
+
+  if (sync_policy == SYNC_NONE)	/* FFSMark */
+    fprintf (fp, "Written files are not synced\n");
+  else if (sync_policy == SYNC_WRITE || sync_policy == SYNC_CLOSE)
+    fprintf (fp, "%s after each %s\n", sync_data ? "fdatasync" : "fsync",
+	     (sync_policy == SYNC_WRITE) ? "write" : "written file");
+  else if (sync_policy == SYNC_EVERY)
+    fprintf (fp, "syncfs after every %d written files\n", sync_count);
+  else
+    fprintf (fp, "%s of batches of %d written files\n",
+	     sync_data ? "fdatasync" : "fsync", sync_count);
+  fprintf (fp, "Report format is %s", report_names[report]);	/* FFSMark */
+  if (report_path[0])
+    fprintf (fp, ", appended to %s", report_path);
+  fprintf (fp, ".\n");
 
   /* ffsmark */
   ffsmark_core_cli_show(fp);
@@ -1535,6 +4322,403 @@ cli_parse_line (buffer)
   return (result);		/* return 1 unless exit requested, then return 0 */
 }
 
+/* FFSMark: parameter sweeps - each swept 'set' command has a list of
+   values, the points being their cartesian product */
+#define SWEEP_MAX_PARAMS 8
+#define SWEEP_MAX_VALUES 256
+#define SWEEP_MAX_POINTS 1000000
+#define SWEEP_CMD_LEN MAX_LINE
+#define SWEEP_VALUE_LEN 64
+
+typedef struct
+{
+  char command[SWEEP_CMD_LEN + 1];	/* 'set' command the values are given
+					   to */
+  int count;
+  char values[SWEEP_MAX_VALUES][SWEEP_VALUE_LEN];
+} sweep_param;
+
+sweep_param sweep_params[SWEEP_MAX_PARAMS];
+int sweep_count = 0;
+int sweep_random = 0;		/* 1=points in random order */
+char sweep_path[MAX_LINE + 1];	/* CSV results, empty=none */
+
+/* trim the spaces around 'text' in place */
+char *
+sweep_trim (text)
+     char *text;
+{
+  char *end;
+
+  while (*text == ' ' || *text == '\t')
+    text++;
+  for (end = text + strlen (text); end > text
+       && (end[-1] == ' ' || end[-1] == '\t'); end--)
+    ;
+  *end = '\0';
+
+  return (text);
+}
+
+/* add 'value' to 'param', expanding 'from..to+step' and 'from..to*factor'
+   ranges - returns 0 on success */
+int
+sweep_add_value (param, value)
+     sweep_param *param;
+     char *value;
+{
+  double from, to, step = 0, v;
+  char op;
+  char *dots, *end;
+  int k, valid;
+
+  if ((dots = strstr (value, "..")))
+    {
+      /* strtod() alone would read "512." out of "512..8192" */
+      *dots = '\0';
+      from = strtod (value, &end);
+      valid = (end != value && !*end);
+      *dots = '.';
+
+      to = strtod (dots + 2, &end);
+      op = *end;
+      valid = valid && end != dots + 2 && op;
+      if (valid)
+	{
+	  step = strtod (end + 1, &end);
+	  valid = !*end && ((op == '+' && step > 0) || (op == '*'
+							&& step > 1));
+	}
+
+      if (!valid)
+	{
+	  fprintf (stderr, "Error: invalid range '%s'\n", value);
+	  return (-1);
+	}
+
+      for (k = 0, v = from; v <= to * (1 + 1e-9); k++)
+	{
+	  if (param->count == SWEEP_MAX_VALUES)
+	    break;
+	  snprintf (param->values[param->count++], SWEEP_VALUE_LEN, "%.10g",
+		    v);
+	  v = (op == '+') ? from + (k + 1) * step : v * step;
+	}
+    }
+  else if (strlen (value) >= SWEEP_VALUE_LEN)
+    {
+      fprintf (stderr, "Error: value '%s' longer than %d characters\n",
+	       value, SWEEP_VALUE_LEN - 1);
+      return (-1);
+    }
+  else if (param->count < SWEEP_MAX_VALUES && *value)
+    snprintf (param->values[param->count++], SWEEP_VALUE_LEN, "%s", value);
+
+  if (param->count == SWEEP_MAX_VALUES)
+    fprintf (stderr, "Warning: sweep limited to %d values per parameter\n",
+	     SWEEP_MAX_VALUES);
+
+  return (0);
+}
+
+/* FFSMark: UI callback for 'sweep add' */
+int
+cli_sweep_add (param)
+     char *param;		/* remainder of command line */
+{
+  sweep_param *p = &sweep_params[sweep_count];
+  char line[MAX_LINE + 1];
+  char *values, *value, *save;
+
+  if (!param || !(values = strchr (param, ':')))
+    {
+      fprintf (stderr, "Error: please indicate a set command, ':' and "
+	       "values separated by '|'\n");
+      return (1);
+    }
+  if (sweep_count == SWEEP_MAX_PARAMS)
+    {
+      fprintf (stderr, "Error: at most %d swept parameters\n",
+	       SWEEP_MAX_PARAMS);
+      return (1);
+    }
+
+  snprintf (line, sizeof (line), "%s", param);
+  line[values - param] = '\0';
+  snprintf (p->command, sizeof (p->command), "%s", sweep_trim (line));
+  p->count = 0;
+
+  snprintf (line, sizeof (line), "%s", values + 1);
+  for (value = strtok_r (line, "|", &save); value;
+       value = strtok_r (NULL, "|", &save))
+    if (sweep_add_value (p, sweep_trim (value)) != 0)
+      return (1);
+
+  if (p->count == 0 || strncmp (p->command, "set ", 4))
+    fprintf (stderr, "Error: please indicate a set command and values\n");
+  else
+    sweep_count++;
+
+  return (1);
+}
+
+/* FFSMark: UI callback for 'sweep clear' */
+int
+cli_sweep_clear (param)
+     char *param;		/* unused */
+{
+  (void) param;
+  sweep_count = 0;
+  return (1);
+}
+
+/* FFSMark: UI callback for 'sweep order' */
+int
+cli_sweep_order (param)
+     char *param;		/* remainder of command line */
+{
+  if (param && !strcmp (param, "sequential"))
+    sweep_random = 0;
+  else if (param && !strcmp (param, "random"))
+    sweep_random = 1;
+  else
+    fprintf (stderr, "Error: please indicate sequential or random\n");
+
+  return (1);
+}
+
+/* FFSMark: UI callback for 'sweep results' */
+int
+cli_sweep_results (param)
+     char *param;		/* remainder of command line */
+{
+  if (param)
+    snprintf (sweep_path, sizeof (sweep_path), "%s", param);
+  else
+    sweep_path[0] = '\0';
+
+  return (1);
+}
+
+/* write 'text' as a CSV field */
+void
+csv_field (fp, text)
+     FILE *fp;
+     const char *text;
+{
+  if (!strpbrk (text, ",\"\n"))
+    {
+      fputs (text, fp);
+      return;
+    }
+
+  fputc ('"', fp);
+  for (; *text; text++)
+    {
+      if (*text == '"')
+	fputc ('"', fp);
+      fputc (*text, fp);
+    }
+  fputc ('"', fp);
+}
+
+/* FFSMark: header line of the sweep results, in a string to free */
+char *
+sweep_header (columns, ncolumns)
+     char (*columns)[RESULTS_NAME_LEN];
+     int ncolumns;
+{
+  char *text = NULL;
+  size_t size = 0;
+  FILE *fp;
+  int i;
+
+  if ((fp = open_memstream (&text, &size)) == NULL)
+    return (NULL);
+
+  fprintf (fp, "point");
+  for (i = 0; i < sweep_count; i++)
+    {
+      fputc (',', fp);
+      csv_field (fp, sweep_params[i].command);
+    }
+  for (i = 0; i < ncolumns; i++)
+    {
+      fputc (',', fp);
+      csv_field (fp, columns[i]);
+    }
+  fputc ('\n', fp);
+  fclose (fp);
+
+  return (text);
+}
+
+/* FFSMark: the sweep results file to append rows under 'header': 'csv' if
+   it is empty or starts with the same header, else a new '<path>.<n>' file
+   - NULL if none can be opened */
+FILE *
+sweep_results_file (csv, header)
+     FILE *csv;
+     char *header;
+{
+  char path[MAX_LINE + 16];
+  char *first = NULL;
+  size_t size = 0;
+  int n, same;
+
+  fseek (csv, 0, SEEK_END);
+  if (ftell (csv) == 0)
+    {
+      fputs (header, csv);
+      return (csv);
+    }
+
+  rewind (csv);			/* "a+": reads from the start, appends */
+  same = getline (&first, &size, csv) != -1 && !strcmp (first, header);
+  free (first);
+  if (same)
+    return (csv);
+
+  fclose (csv);
+  for (n = 1; n < 1000; n++)
+    {
+      snprintf (path, sizeof (path), "%s.%d", sweep_path, n);
+      if (access (path, F_OK) != 0)
+	break;
+    }
+  if ((csv = fopen (path, "w")) == NULL)
+    {
+      fprintf (stderr, "Error: Cannot write sweep results to '%s'\n", path);
+      return (NULL);
+    }
+
+  fprintf (stderr, "Warning: '%s' has other columns, sweep results written "
+	   "to '%s'\n", sweep_path, path);
+  fputs (header, csv);
+  return (csv);
+}
+
+/* FFSMark: UI callback for 'sweep run' - the metrics of the first point
+   give the CSV columns, a later point missing one leaves it empty. The
+   swept parameters are not restored afterwards: they keep the values of the
+   last point, which are printed */
+int
+cli_sweep_run (param)
+     char *param;		/* optional: name of output file */
+{
+  char line[SWEEP_CMD_LEN + SWEEP_VALUE_LEN + 2];
+  char (*columns)[RESULTS_NAME_LEN] = NULL;
+  char *header;
+  int *order;
+  int points = 1, ncolumns = 0, last = 0;
+  int k, i, j, index, swap;
+  double mean;
+  FILE *csv = NULL;
+
+  for (i = 0; i < sweep_count; i++)
+    if ((points *= sweep_params[i].count) > SWEEP_MAX_POINTS)
+      {
+	fprintf (stderr, "Error: more than %d sweep points\n",
+		 SWEEP_MAX_POINTS);
+	return (1);
+      }
+
+  if ((order = malloc (points * sizeof (int))) == NULL
+      || (columns = malloc (RESULTS_MAX_METRICS * RESULTS_NAME_LEN)) == NULL)
+    {
+      fprintf (stderr, "Error: cannot allocate the sweep\n");
+      free (order);
+      return (1);
+    }
+
+  /* Fisher-Yates shuffle by a counter-based draw, reproducible per seed */
+  for (k = 0; k < points; k++)
+    order[k] = k;
+  for (k = points - 1; sweep_random && k > 0; k--)
+    {
+      j = datagen_word (seed, k) % (k + 1);
+      swap = order[k];
+      order[k] = order[j];
+      order[j] = swap;
+    }
+
+  if (sweep_path[0] && (csv = fopen (sweep_path, "a+")) == NULL)
+    fprintf (stderr, "Error: Cannot write sweep results to '%s'\n",
+	     sweep_path);
+
+  for (k = 0; k < points; k++)
+    {
+      printf ("\nSweep point %d/%d:", k + 1, points);
+      last = order[k];
+      for (i = 0, index = last; i < sweep_count; i++)
+	{
+	  j = index % sweep_params[i].count;
+	  index /= sweep_params[i].count;
+	  snprintf (line, sizeof (line), "%.*s %.*s", SWEEP_CMD_LEN,
+		    sweep_params[i].command, SWEEP_VALUE_LEN - 1,
+		    sweep_params[i].values[j]);
+	  printf (" [%s]", line);
+	  cli_parse_line (line);
+	}
+      printf ("\n");
+
+      cli_run (param);
+      if (!csv)
+	continue;
+
+      if (k == 0)
+	{
+	  ncolumns = results_metrics ();
+	  for (i = 0; i < ncolumns; i++)
+	    strcpy (columns[i], results_name (i));
+
+	  if ((header = sweep_header (columns, ncolumns)) != NULL)
+	    csv = sweep_results_file (csv, header);
+	  else
+	    {
+	      fprintf (stderr, "Error: cannot allocate the sweep header\n");
+	      fclose (csv);
+	      csv = NULL;
+	    }
+	  free (header);
+	  if (!csv)
+	    continue;
+	}
+
+      fprintf (csv, "%d", order[k]);
+      for (i = 0, index = order[k]; i < sweep_count; i++)
+	{
+	  fputc (',', csv);
+	  csv_field (csv, sweep_params[i].values[index %
+						 sweep_params[i].count]);
+	  index /= sweep_params[i].count;
+	}
+      for (i = 0; i < ncolumns; i++)
+	if (!isnan (mean = results_mean (columns[i])))
+	  fprintf (csv, ",%.6g", mean);
+	else
+	  fputc (',', csv);
+      fputc ('\n', csv);
+      fflush (csv);		/* rows survive an interrupted campaign */
+    }
+
+  printf ("\nSwept parameters left at the last point:");
+  for (i = 0, index = last; i < sweep_count; i++)
+    {
+      printf (" [%s %s]", sweep_params[i].command,
+	      sweep_params[i].values[index % sweep_params[i].count]);
+      index /= sweep_params[i].count;
+    }
+  printf ("\n");
+
+  if (csv)
+    fclose (csv);
+  free (columns);
+  free (order);
+
+  return (1);
+}
+
 /* read config file if present and process it line by line
    - if 'quit' is in file then function returns 0 */
 int
@@ -1631,8 +4815,9 @@ main (argc, argv)
 #define TEMPERING_SHIFT_T(y)  (y << 15)
 #define TEMPERING_SHIFT_L(y)  (y >> 18)
 
-static unsigned long mt[N];	/* the array for the state vector  */
-static int mti = N + 1;		/* mti==N+1 means mt[N] is not initialized */
+/* FFSMark: one generator state per thread */
+static __thread unsigned long mt[N];	/* the array for the state vector  */
+static __thread int mti = N + 1;	/* mti==N+1 means mt[N] is not initialized */
 
 /* Initializing the array with a seed */
 void
@@ -0,0 +1,215 @@
+/*
+ * FFSMark
+ * Pierre Olivier <pierre.olivier@univ-brest.fr>
+ *
+ * Copyright (c) of University of Occidental Britanny (UBO) <pierre.olivier@univ-brest.fr>, 2015.
+ *
+ *	This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ * NO WARRANTY. THIS SOFTWARE IS FURNISHED ON AN "AS IS" BASIS.
+ * UNIVERSITY OF OCCIDENTAL BRITANNY MAKES NO WARRANTIES OF ANY KIND, EITHER
+ * EXPRESSED OR IMPLIED AS TO THE MATTER INCLUDING, BUT NOT LIMITED
+ * TO: WARRANTY OF FITNESS FOR PURPOSE OR MERCHANTABILITY, EXCLUSIVITY
+ * OF RESULTS OR RESULTS OBTAINED FROM USE OF THIS SOFTWARE. 
+ * See the GNU General Public License for more details.
+ *
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "report.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+typedef struct
+{
+  char key[REPORT_KEY_LEN];
+  char value[REPORT_VALUE_LEN];
+  int quoted;                 /* string value */
+} report_field;
+
+static report_field *fields = NULL;
+static int nfields, max_fields;
+static int dropped;            /* fields lost for lack of memory */
+
+void report_reset()
+{
+  nfields = 0;
+  dropped = 0;
+}
+
+static report_field *report_add(const char *key)
+{
+  report_field *f;
+
+  if(nfields == max_fields)
+  {
+    f = (report_field *)realloc(fields,
+      (max_fields + REPORT_FIELDS_BLOCK) * sizeof(report_field));
+    if(f == NULL)
+    {
+      if(!dropped++)
+        fprintf(stderr, "Error: out of memory, the report is incomplete\n");
+      return NULL;
+    }
+    fields = f;
+    max_fields += REPORT_FIELDS_BLOCK;
+  }
+
+  f = &fields[nfields++];
+  snprintf(f->key, sizeof(f->key), "%s", key);
+  return f;
+}
+
+void report_number(const char *key, double value)
+{
+  report_field *f = report_add(key);
+
+  if(!f)
+    return;
+  if(isfinite(value))
+    snprintf(f->value, sizeof(f->value), "%.10g", value);
+  else
+    strcpy(f->value, "null");  /* e.g. a rate over an empty phase */
+  f->quoted = 0;
+}
+
+void report_integer(const char *key, long long value)
+{
+  report_field *f = report_add(key);
+
+  if(!f)
+    return;
+  snprintf(f->value, sizeof(f->value), "%lld", value);
+  f->quoted = 0;
+}
+
+void report_string(const char *key, const char *value)
+{
+  report_field *f = report_add(key);
+
+  if(!f)
+    return;
+  snprintf(f->value, sizeof(f->value), "%s", value);
+  f->quoted = 1;
+}
+
+static void json_string(FILE *fp, const char *s, int len)
+{
+  int i;
+
+  fputc('"', fp);
+  for(i = 0; i < len && s[i]; i++)
+  {
+    if(s[i] == '"' || s[i] == '\\')
+      fprintf(fp, "\\%c", s[i]);
+    else if((unsigned char)s[i] < 0x20)
+      fprintf(fp, "\\u%04x", s[i]);
+    else
+      fputc(s[i], fp);
+  }
+  fputc('"', fp);
+}
+
+/* number of dot separated components of key before 'len' */
+static int key_depth(const char *key, int len)
+{
+  int i, depth = 0;
+
+  for(i = 0; i < len; i++)
+    depth += (key[i] == '.');
+  return depth;
+}
+
+/**
+ * Keys sharing a prefix are expected to be consecutive: the objects of the
+ * previous key are closed down to the common prefix, then the new ones
+ * opened
+ */
+void report_write_json(FILE *fp)
+{
+  const char *prev = "", *key, *dot;
+  int i, common, open = 0, first = 1, start;
+
+  fprintf(fp, "{");
+  for(i = 0; i < nfields; i++)
+  {
+    key = fields[i].key;
+
+    /* length of the common prefix, in whole components */
+    for(common = 0, start = 0; prev[common] && prev[common] == key[common];
+      common++)
+      if(key[common] == '.')
+        start = common + 1;
+
+    for(; open > key_depth(key, start); open--)
+      fprintf(fp, "}");
+    if(!first)
+      fprintf(fp, ",");
+
+    /* objects of the remaining components */
+    while((dot = strchr(key + start, '.')))
+    {
+      json_string(fp, key + start, dot - (key + start));
+      fprintf(fp, ":{");
+      start = dot - key + 1;
+      open++;
+    }
+
+    json_string(fp, key + start, REPORT_KEY_LEN);
+    fputc(':', fp);
+    if(fields[i].quoted)
+      json_string(fp, fields[i].value, REPORT_VALUE_LEN);
+    else
+      fputs(fields[i].value, fp);
+
+    prev = key;
+    first = 0;
+  }
+
+  for(; open > 0; open--)
+    fprintf(fp, "}");
+  fprintf(fp, "}\n");
+}
+
+static void csv_string(FILE *fp, const char *s)
+{
+  if(!strpbrk(s, ",\"\n"))
+  {
+    fputs(s, fp);
+    return;
+  }
+
+  fputc('"', fp);
+  for(; *s; s++)
+  {
+    if(*s == '"')
+      fputc('"', fp);
+    fputc(*s, fp);
+  }
+  fputc('"', fp);
+}
+
+void report_write_csv(FILE *fp, int header)
+{
+  int i;
+
+  for(i = 0; header && i < nfields; i++)
+  {
+    csv_string(fp, fields[i].key);
+    fputc((i == nfields - 1) ? '\n' : ',', fp);
+  }
+
+  for(i = 0; i < nfields; i++)
+  {
+    if(fields[i].quoted || strcmp(fields[i].value, "null"))
+      csv_string(fp, fields[i].value);
+    fputc((i == nfields - 1) ? '\n' : ',', fp);
+  }
+}
@@ -0,0 +1,52 @@
+/*
+ * FFSMark
+ * Pierre Olivier <pierre.olivier@univ-brest.fr>
+ *
+ * Copyright (c) of University of Occidental Britanny (UBO) <pierre.olivier@univ-brest.fr>, 2015.
+ *
+ *	This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ * NO WARRANTY. THIS SOFTWARE IS FURNISHED ON AN "AS IS" BASIS.
+ * UNIVERSITY OF OCCIDENTAL BRITANNY MAKES NO WARRANTIES OF ANY KIND, EITHER
+ * EXPRESSED OR IMPLIED AS TO THE MATTER INCLUDING, BUT NOT LIMITED
+ * TO: WARRANTY OF FITNESS FOR PURPOSE OR MERCHANTABILITY, EXCLUSIVITY
+ * OF RESULTS OR RESULTS OBTAINED FROM USE OF THIS SOFTWARE. 
+ * See the GNU General Public License for more details.
+ *
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef REPORT_H
+#define REPORT_H
+
+#include <stdio.h>
+
+/**
+ * Structured report of a run: fields are added in order under dotted keys
+ * ("latency.transactions.read.p99_us"), then written as a single JSON
+ * object (one per line, nested by key prefix, so that results files can be
+ * appended to) or as a CSV row, the header being written first when asked.
+ */
+#define REPORT_FIELDS_BLOCK 256  /* the field table grows by this many */
+#define REPORT_KEY_LEN      96
+#define REPORT_VALUE_LEN    160
+
+#define REPORT_VERBOSE  0
+#define REPORT_TERSE    1
+#define REPORT_JSON     2
+#define REPORT_CSV      3
+
+void report_reset();
+void report_number(const char *key, double value);
+void report_integer(const char *key, long long value);
+void report_string(const char *key, const char *value);
+void report_write_json(FILE *fp);
+void report_write_csv(FILE *fp, int header);
+
+#endif /* REPORT_H */
@@ -0,0 +1,205 @@
+/*
+ * FFSMark
+ * Pierre Olivier <pierre.olivier@univ-brest.fr>
+ *
+ * Copyright (c) of University of Occidental Britanny (UBO) <pierre.olivier@univ-brest.fr>, 2015.
+ *
+ *	This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ * NO WARRANTY. THIS SOFTWARE IS FURNISHED ON AN "AS IS" BASIS.
+ * UNIVERSITY OF OCCIDENTAL BRITANNY MAKES NO WARRANTIES OF ANY KIND, EITHER
+ * EXPRESSED OR IMPLIED AS TO THE MATTER INCLUDING, BUT NOT LIMITED
+ * TO: WARRANTY OF FITNESS FOR PURPOSE OR MERCHANTABILITY, EXCLUSIVITY
+ * OF RESULTS OR RESULTS OBTAINED FROM USE OF THIS SOFTWARE. 
+ * See the GNU General Public License for more details.
+ *
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "results.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+typedef struct
+{
+  char name[RESULTS_NAME_LEN];
+  double *values;             /* one per iteration, NAN when missing */
+} results_metric;
+
+static results_metric metrics[RESULTS_MAX_METRICS];
+static int nmetrics;
+static int iterations;
+static int capacity;          /* values allocated per metric */
+
+/* two-sided 95% Student's t quantiles for 1 to 30 degrees of freedom */
+static const double t95[] = {12.706, 4.303, 3.182, 2.776, 2.571, 2.447,
+  2.365, 2.306, 2.262, 2.228, 2.201, 2.179, 2.160, 2.145, 2.131, 2.120,
+  2.110, 2.101, 2.093, 2.086, 2.080, 2.074, 2.069, 2.064, 2.060, 2.056,
+  2.052, 2.048, 2.045, 2.042};
+
+static double t_quantile(int df)
+{
+  if(df <= 30)
+    return t95[df - 1];
+  if(df <= 40)
+    return 2.021;
+  if(df <= 60)
+    return 2.000;
+  if(df <= 120)
+    return 1.980;
+  return 1.960;
+}
+
+void results_reset()
+{
+  int i;
+
+  for(i = 0; i < nmetrics; i++)
+    free(metrics[i].values);
+  nmetrics = iterations = capacity = 0;
+}
+
+void results_begin_iteration()
+{
+  double *values;
+  int i;
+
+  if(iterations == capacity)
+  {
+    capacity = capacity ? capacity * 2 : 16;
+    for(i = 0; i < nmetrics; i++)
+    {
+      if((values = realloc(metrics[i].values, capacity * sizeof(double)))
+        == NULL)
+      {
+        fprintf(stderr, "Error: cannot allocate results\n");
+        exit(EXIT_FAILURE);
+      }
+      metrics[i].values = values;
+    }
+  }
+
+  for(i = 0; i < nmetrics; i++)
+    metrics[i].values[iterations] = NAN;
+  iterations++;
+}
+
+void results_add(const char *name, double value)
+{
+  int i, j;
+
+  if(iterations == 0)
+    return;
+
+  for(i = 0; i < nmetrics && strcmp(metrics[i].name, name); i++)
+    ;
+
+  if(i == nmetrics)
+  {
+    if(nmetrics == RESULTS_MAX_METRICS)
+      return;
+    if((metrics[i].values = malloc(capacity * sizeof(double))) == NULL)
+    {
+      fprintf(stderr, "Error: cannot allocate results\n");
+      exit(EXIT_FAILURE);
+    }
+    strncpy(metrics[i].name, name, RESULTS_NAME_LEN - 1);
+    metrics[i].name[RESULTS_NAME_LEN - 1] = '\0';
+    for(j = 0; j < iterations; j++)   /* metric absent until now */
+      metrics[i].values[j] = NAN;
+    nmetrics++;
+  }
+
+  metrics[i].values[iterations - 1] = value;
+}
+
+int results_iterations()
+{
+  return iterations;
+}
+
+int results_metrics()
+{
+  return nmetrics;
+}
+
+const char *results_name(int metric)
+{
+  return metrics[metric].name;
+}
+
+/**
+ * Mean of metric 'name' over the iterations, NAN when it has no value
+ */
+double results_mean(const char *name)
+{
+  double sum = 0;
+  int i, j, n = 0;
+
+  for(i = 0; i < nmetrics && strcmp(metrics[i].name, name); i++)
+    ;
+
+  for(j = 0; i < nmetrics && j < iterations; j++)
+    if(!isnan(metrics[i].values[j]))
+    {
+      sum += metrics[i].values[j];
+      n++;
+    }
+
+  return n ? sum / n : NAN;
+}
+
+void results_summary(FILE *fp)
+{
+  double sum, mean, var, min, max, ci, v;
+  int i, j, n, width = 0;
+
+  for(i = 0; i < nmetrics; i++)
+    if((int)strlen(metrics[i].name) > width)
+      width = strlen(metrics[i].name);
+
+  fprintf(fp, "\nSummary of %d iterations (95%% confidence interval of the "
+    "mean):\n", iterations);
+  fprintf(fp, "\t%-*s %14s %14s %14s %14s %14s\n", width, "metric", "mean",
+    "stddev", "min", "max", "+/-");
+
+  for(i = 0; i < nmetrics; i++)
+  {
+    sum = 0;
+    n = 0;
+    min = INFINITY;
+    max = -INFINITY;
+    for(j = 0; j < iterations; j++)
+    {
+      if(isnan(v = metrics[i].values[j]))
+        continue;
+      sum += v;
+      n++;
+      min = (v < min) ? v : min;
+      max = (v > max) ? v : max;
+    }
+    if(n == 0)
+      continue;
+
+    mean = sum / n;
+    var = 0;
+    for(j = 0; j < iterations; j++)
+      if(!isnan(v = metrics[i].values[j]))
+        var += (v - mean) * (v - mean);
+    var = (n > 1) ? var / (n - 1) : 0;
+    ci = (n > 1) ? t_quantile(n - 1) * sqrt(var / n) : 0;
+
+    fprintf(fp, "\t%-*s %14.3lf %14.3lf %14.3lf %14.3lf %14.3lf", width,
+      metrics[i].name, mean, sqrt(var), min, max, ci);
+    if(n < iterations)
+      fprintf(fp, " (%d iterations)", n);
+    fprintf(fp, "\n");
+  }
+}
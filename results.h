@@ -0,0 +1,47 @@
+/*
+ * FFSMark
+ * Pierre Olivier <pierre.olivier@univ-brest.fr>
+ *
+ * Copyright (c) of University of Occidental Britanny (UBO) <pierre.olivier@univ-brest.fr>, 2015.
+ *
+ *	This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ * NO WARRANTY. THIS SOFTWARE IS FURNISHED ON AN "AS IS" BASIS.
+ * UNIVERSITY OF OCCIDENTAL BRITANNY MAKES NO WARRANTIES OF ANY KIND, EITHER
+ * EXPRESSED OR IMPLIED AS TO THE MATTER INCLUDING, BUT NOT LIMITED
+ * TO: WARRANTY OF FITNESS FOR PURPOSE OR MERCHANTABILITY, EXCLUSIVITY
+ * OF RESULTS OR RESULTS OBTAINED FROM USE OF THIS SOFTWARE. 
+ * See the GNU General Public License for more details.
+ *
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef RESULTS_H
+#define RESULTS_H
+
+#include <stdio.h>
+
+/**
+ * Named metrics of the measured iterations of a run: every iteration adds
+ * its values, the summary gives their mean, standard deviation, range and
+ * 95% confidence interval of the mean (Student's t).
+ */
+#define RESULTS_MAX_METRICS   256
+#define RESULTS_NAME_LEN      64
+
+void results_reset();
+void results_begin_iteration();
+void results_add(const char *name, double value);
+int results_iterations();
+int results_metrics();
+const char *results_name(int metric);
+double results_mean(const char *name);
+void results_summary(FILE *fp);
+
+#endif /* RESULTS_H */
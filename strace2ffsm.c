@@ -0,0 +1,1027 @@
+/*
+ * FFSMark
+ * Pierre Olivier <pierre.olivier@univ-brest.fr>
+ *
+ * Copyright (c) of University of Occidental Britanny (UBO) <pierre.olivier@univ-brest.fr>, 2015.
+ *
+ *	This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ * NO WARRANTY. THIS SOFTWARE IS FURNISHED ON AN "AS IS" BASIS.
+ * UNIVERSITY OF OCCIDENTAL BRITANNY MAKES NO WARRANTIES OF ANY KIND, EITHER
+ * EXPRESSED OR IMPLIED AS TO THE MATTER INCLUDING, BUT NOT LIMITED
+ * TO: WARRANTY OF FITNESS FOR PURPOSE OR MERCHANTABILITY, EXCLUSIVITY
+ * OF RESULTS OR RESULTS OBTAINED FROM USE OF THIS SOFTWARE.
+ * See the GNU General Public License for more details.
+ *
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * strace2ffsm: converts a strace log into a FFSMark operation trace for
+ * 'set replay'. The log is expected from:
+ *
+ *   strace -f -tt [-T] -e trace=file,desc,process -o app.strace <application>
+ *
+ * (-ttt timestamps work too). Every regular file touched is given an id,
+ * replayed as r<id> under the FFSMark location. Files used before being
+ * created by the application get a preload record sized after the largest
+ * offset read or written in them. The process calls give the descriptor
+ * table of each pid: shared by threads, copied by fork(). The log is streamed, only the per-file state is
+ * kept in memory.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <time.h>
+
+#include "optrace.h"
+
+#define MAX_LINE        65536
+#define MAX_ARGS        8
+#define HASH_SIZE       4096
+#define MAX_PENDING     1024
+#define MAX_THREADS     256
+#define DAY_NS          (86400ULL * 1000000000ULL)
+
+typedef struct file_struct
+{
+  char *path;
+  uint32_t id;
+  int seen;                   /* referenced by the trace already */
+  int exists;
+  int preload;                /* existed before the trace */
+  int tracked;                /* preload extent still meaningful */
+  uint64_t extent;            /* preload: largest offset accessed */
+  uint64_t size;
+  struct file_struct *next;
+} file;
+
+typedef struct fd_struct
+{
+  int table;                  /* descriptor table, see fd_table() */
+  int fd;
+  char *path;                 /* kept for *at() calls relative to it */
+  file *f;                    /* NULL if outside the replay root */
+  uint64_t pos;
+  int append;
+  int dup;                    /* from dup*() or inherited by a child
+                                 process, its close is not recorded */
+  struct fd_struct *next;
+} fd_entry;
+
+typedef struct process_struct
+{
+  int pid;
+  int table;
+  struct process_struct *next;
+} process;
+
+typedef struct
+{
+  int pid;
+  uint64_t start;
+  char *text;
+} pending_call;
+
+static file *files[HASH_SIZE];
+static fd_entry *fds[HASH_SIZE];
+static process *processes[HASH_SIZE];
+static pending_call pending[MAX_PENDING];
+static int threads[MAX_THREADS];
+static int thread_count = 0;
+static uint32_t next_id = 1;
+static char *root = NULL;
+static char cwd[MAX_LINE] = "";
+
+static FILE *body;
+static uint64_t first_ts = 0, last_ts = 0, day_offset = 0;
+static int epoch_ts = 0;
+static unsigned long records = 0, skipped = 0;
+
+/* ---------------------------------------------------------------------- */
+
+static void usage(char *prog)
+{
+  fprintf(stderr, "Usage: %s [-r root] [-m map] <strace log | -> <trace>\n"
+    "  -r root  only keep the files under root (default: all but /proc, "
+    "/sys, /dev)\n"
+    "  -m map   write the id of each file to map\n", prog);
+}
+
+static unsigned int hash_string(char *s)
+{
+  unsigned int h = 5381;
+
+  while(*s)
+    h = h * 33 + (unsigned char)*s++;
+
+  return h % HASH_SIZE;
+}
+
+static int thread_index(int pid)
+{
+  int i;
+
+  for(i = 0; i < thread_count; i++)
+    if(threads[i] == pid)
+      return i;
+
+  if(thread_count < MAX_THREADS)
+    threads[thread_count++] = pid;
+
+  return (thread_count - 1) % MAX_THREADS;
+}
+
+/* ---------------------------------------------------------------------- */
+/* Paths */
+
+/**
+ * Collapse "//", "/./" and "dir/../" of an absolute path in place
+ */
+static void normalize_path(char *path)
+{
+  char *src = path, *dst = path;
+
+  if(*path != '/')
+    return;
+
+  while(*src)
+  {
+    if(src[0] == '/' && (src[1] == '/' || src[1] == '\0') && dst != path)
+      src++;
+    else if(src[0] == '/' && src[1] == '.' && (src[2] == '/' || !src[2]))
+      src += 2;
+    else if(src[0] == '/' && src[1] == '.' && src[2] == '.'
+      && (src[3] == '/' || !src[3]))
+    {
+      src += 3;
+      while(dst > path && *--dst != '/')
+        ;
+    }
+    else
+      *dst++ = *src++;
+  }
+
+  if(dst == path)
+    *dst++ = '/';
+  *dst = '\0';
+}
+
+/**
+ * Absolute path of 'name' relative to 'dir' (cwd when NULL)
+ */
+static void resolve_path(char *dest, char *dir, char *name)
+{
+  char *base = dir ? dir : cwd;
+  size_t len = strlen(base);
+
+  if(name[0] == '/' || base[0] == '\0'
+    || len + strlen(name) + 2 > MAX_LINE)
+    snprintf(dest, MAX_LINE, "%s", name);
+  else
+  {
+    memcpy(dest, base, len);
+    dest[len] = '/';
+    strcpy(dest + len + 1, name);
+  }
+
+  normalize_path(dest);
+}
+
+static int in_root(char *path)
+{
+  size_t len;
+
+  if(root == NULL)
+    return strncmp(path, "/proc/", 6) && strncmp(path, "/sys/", 5)
+      && strncmp(path, "/dev/", 5);
+
+  len = strlen(root);
+  return !strncmp(path, root, len) && (path[len] == '/' || !path[len]
+    || root[len - 1] == '/');
+}
+
+static file *lookup_file(char *path)
+{
+  unsigned int h = hash_string(path);
+  file *f;
+
+  for(f = files[h]; f; f = f->next)
+    if(!strcmp(f->path, path))
+      return f;
+
+  f = (file *)calloc(1, sizeof(file));
+  if(f == NULL || (f->path = strdup(path)) == NULL)
+  {
+    fprintf(stderr, "Error: out of memory\n");
+    exit(EXIT_FAILURE);
+  }
+  f->id = next_id++;
+  f->next = files[h];
+  files[h] = f;
+
+  return f;
+}
+
+/* ---------------------------------------------------------------------- */
+/* File descriptors: each pid uses a descriptor table, named after the pid
+ * it was created for. A thread (clone with CLONE_FILES) shares the table of
+ * its parent, a child process gets a copy of it, and a pid seen without its
+ * creation has a table of its own. */
+
+static process *lookup_process(int pid)
+{
+  process *p;
+
+  for(p = processes[(unsigned int)pid % HASH_SIZE]; p; p = p->next)
+    if(p->pid == pid)
+      return p;
+
+  return NULL;
+}
+
+static int fd_table(int pid)
+{
+  process *p = lookup_process(pid);
+
+  return p ? p->table : pid;
+}
+
+static void set_fd_table(int pid, int table)
+{
+  process *p = lookup_process(pid);
+
+  if(p == NULL)
+  {
+    if((p = (process *)calloc(1, sizeof(process))) == NULL)
+    {
+      fprintf(stderr, "Error: out of memory\n");
+      exit(EXIT_FAILURE);
+    }
+    p->pid = pid;
+    p->next = processes[(unsigned int)pid % HASH_SIZE];
+    processes[(unsigned int)pid % HASH_SIZE] = p;
+  }
+  p->table = table;
+}
+
+static fd_entry *lookup_fd(int pid, int fd)
+{
+  int table = fd_table(pid);
+  fd_entry *e;
+
+  for(e = fds[(unsigned int)fd % HASH_SIZE]; e; e = e->next)
+    if(e->fd == fd && e->table == table)
+      return e;
+
+  return NULL;
+}
+
+static void remove_fd(fd_entry *e)
+{
+  fd_entry **p;
+
+  for(p = &fds[(unsigned int)e->fd % HASH_SIZE]; *p; p = &(*p)->next)
+    if(*p == e)
+    {
+      *p = e->next;
+      free(e->path);
+      free(e);
+      return;
+    }
+}
+
+static fd_entry *add_fd(int pid, int fd, char *path, file *f)
+{
+  fd_entry *e = (fd_entry *)calloc(1, sizeof(fd_entry));
+
+  if(e == NULL || (e->path = strdup(path)) == NULL)
+  {
+    fprintf(stderr, "Error: out of memory\n");
+    exit(EXIT_FAILURE);
+  }
+  e->table = fd_table(pid);
+  e->fd = fd;
+  e->f = f;
+  e->next = fds[(unsigned int)fd % HASH_SIZE];
+  fds[(unsigned int)fd % HASH_SIZE] = e;
+
+  return e;
+}
+
+/* ---------------------------------------------------------------------- */
+/* Output */
+
+static void emit(optrace_op op, file *f, uint64_t offset, uint64_t size,
+  uint32_t aux, uint64_t start, uint64_t end, int pid)
+{
+  optrace_record rec;
+
+  memset(&rec, 0, sizeof(rec));
+  rec.start = start;
+  rec.end = end;
+  rec.offset = offset;
+  rec.file_id = f->id;
+  rec.size = (size > UINT32_MAX) ? UINT32_MAX : (uint32_t)size;
+  rec.aux = aux;
+  rec.op = op;
+  rec.thread = thread_index(pid);
+
+  fwrite(&rec, sizeof(rec), 1, body);
+  records++;
+}
+
+/**
+ * A file used before the application created it existed beforehand
+ */
+static void first_use(file *f)
+{
+  if(f->seen)
+    return;
+
+  f->seen = 1;
+  f->exists = 1;
+  f->preload = 1;
+  f->tracked = 1;
+}
+
+static int write_trace(char *path, char *map_path)
+{
+  optrace_header h;
+  optrace_record rec;
+  FILE *out, *map = NULL;
+  file *f;
+  size_t n;
+  int i;
+
+  if((out = fopen(path, "w")) == NULL)
+  {
+    fprintf(stderr, "Error: cannot open trace file '%s'\n", path);
+    return -1;
+  }
+
+  if(map_path && (map = fopen(map_path, "w")) == NULL)
+    fprintf(stderr, "Error: cannot open map file '%s'\n", map_path);
+
+  memset(&h, 0, sizeof(h));
+  memcpy(h.magic, OPTRACE_MAGIC, sizeof(h.magic));
+  h.version = OPTRACE_VERSION;
+  h.record_size = sizeof(optrace_record);
+  h.monotonic_base = first_ts;
+  h.realtime_base = epoch_ts ? first_ts : 0;
+  fwrite(&h, sizeof(h), 1, out);
+
+  /* preload records first, then the converted operations */
+  for(i = 0; i < HASH_SIZE; i++)
+    for(f = files[i]; f; f = f->next)
+    {
+      if(map)
+        fprintf(map, "%u\t%s\n", f->id, f->path);
+
+      if(!f->preload)
+        continue;
+
+      memset(&rec, 0, sizeof(rec));
+      rec.start = rec.end = first_ts;
+      rec.file_id = f->id;
+      rec.size = (f->extent > UINT32_MAX) ? UINT32_MAX : (uint32_t)f->extent;
+      rec.aux = OPTRACE_CREATE_PRELOAD;
+      rec.op = OPTRACE_CREATE;
+      fwrite(&rec, sizeof(rec), 1, out);
+    }
+
+  rewind(body);
+  while((n = fread(&rec, 1, sizeof(rec), body)) == sizeof(rec))
+    fwrite(&rec, sizeof(rec), 1, out);
+
+  if(map)
+    fclose(map);
+
+  if(fclose(out))
+  {
+    perror("fclose");
+    return -1;
+  }
+
+  return 0;
+}
+
+/* ---------------------------------------------------------------------- */
+/* Parsing */
+
+/**
+ * Decode a strace string argument (quoted, C escapes) into dest
+ */
+static int parse_string(char *dest, char *arg)
+{
+  char *d = dest;
+  int v, n;
+
+  if(*arg++ != '"')
+    return -1;
+
+  while(*arg && *arg != '"' && d - dest < MAX_LINE - 1)
+  {
+    if(*arg != '\\')
+    {
+      *d++ = *arg++;
+      continue;
+    }
+
+    arg++;
+    switch(*arg)
+    {
+      case 'n': *d++ = '\n'; arg++; break;
+      case 't': *d++ = '\t'; arg++; break;
+      case 'r': *d++ = '\r'; arg++; break;
+      case 'x':
+        if(sscanf(arg + 1, "%2x%n", &v, &n) == 1)
+        {
+          *d++ = v;
+          arg += 1 + n;
+        }
+        break;
+      default:
+        if(*arg >= '0' && *arg <= '7' && sscanf(arg, "%3o%n", &v, &n) == 1)
+        {
+          *d++ = v;
+          arg += n;
+        }
+        else if(*arg)
+          *d++ = *arg++;
+    }
+  }
+  *d = '\0';
+
+  return 0;
+}
+
+/**
+ * Split the arguments of "name(args) = ret <dur>" in place. Returns the
+ * number of arguments, -1 if the line is not a complete call.
+ */
+static int split_call(char *call, char **name, char **args, long long *ret,
+  double *duration)
+{
+  char *p = call, *q;
+  int depth = 0, quoted = 0, count = 0;
+
+  *name = call;
+  if((p = strchr(call, '(')) == NULL)
+    return -1;
+  *p++ = '\0';
+
+  while(*p == ' ')
+    p++;
+  args[count] = p;
+
+  for(; *p; p++)
+  {
+    if(quoted)
+    {
+      if(*p == '\\' && p[1])
+        p++;
+      else if(*p == '"')
+        quoted = 0;
+      continue;
+    }
+
+    if(*p == '"')
+      quoted = 1;
+    else if(*p == '(' || *p == '{' || *p == '[')
+      depth++;
+    else if((*p == '}' || *p == ']') && depth > 0)
+      depth--;
+    else if(*p == ')' && depth > 0)
+      depth--;
+    else if(*p == ')')
+      break;
+    else if(*p == ',' && depth == 0 && count < MAX_ARGS - 1)
+    {
+      *p = '\0';
+      while(p[1] == ' ')
+        p++;
+      args[++count] = p + 1;
+    }
+  }
+
+  if(*p != ')')
+    return -1;
+  *p++ = '\0';
+  if(*args[0] || count)
+    count++;
+
+  while(*p == ' ')
+    p++;
+  if(*p++ != '=')
+    return -1;
+  if(sscanf(p, " %lld", ret) != 1)
+    return -1;            /* "= ?" */
+
+  *duration = 0.0;
+  if((q = strrchr(p, '<')) && sscanf(q, "<%lf>", duration) != 1)
+    *duration = 0.0;
+
+  return count;
+}
+
+static long long arg_number(char *arg)
+{
+  return strtoll(arg, NULL, 0);
+}
+
+static char *dirfd_path(int pid, char *arg)
+{
+  fd_entry *e;
+
+  if(!strncmp(arg, "AT_FDCWD", 8))
+    return NULL;
+
+  e = lookup_fd(pid, (int)arg_number(arg));
+  return e ? e->path : NULL;
+}
+
+/* ---------------------------------------------------------------------- */
+/* System calls */
+
+static void do_open(int pid, char *dir, char *name, char *flags, int fd,
+  uint64_t start, uint64_t end)
+{
+  char path[MAX_LINE];
+  fd_entry *e;
+  file *f = NULL;
+  uint32_t aux = 0;
+
+  resolve_path(path, dir, name);
+  if((e = lookup_fd(pid, fd)))
+    remove_fd(e);           /* close missed in the log */
+
+  if(in_root(path) && !strstr(flags, "O_DIRECTORY"))
+  {
+    f = lookup_file(path);
+
+    if(strstr(flags, "O_CREAT"))
+      aux |= OPTRACE_OPEN_CREATE;
+    if(strstr(flags, "O_TRUNC"))
+      aux |= OPTRACE_OPEN_TRUNCATE;
+
+    if(!f->seen && !(aux & OPTRACE_OPEN_CREATE))
+      first_use(f);
+    else if(!f->exists)
+      aux |= OPTRACE_OPEN_CREATE;   /* recreated */
+    f->seen = 1;
+
+    if(!f->exists || (aux & OPTRACE_OPEN_TRUNCATE))
+    {
+      f->size = 0;
+      f->tracked = 0;
+    }
+    f->exists = 1;
+
+    emit(OPTRACE_OPEN, f, 0, 0, aux, start, end, pid);
+  }
+
+  e = add_fd(pid, fd, path, f);
+  e->append = (strstr(flags, "O_APPEND") != NULL);
+}
+
+static void do_io(int pid, int fd, int is_write, long long offset,
+  long long done, uint64_t start, uint64_t end)
+{
+  fd_entry *e = lookup_fd(pid, fd);
+  file *f;
+
+  if(e == NULL || (f = e->f) == NULL)
+    return;
+
+  if(offset < 0)            /* at the current position */
+  {
+    offset = (is_write && e->append) ? (long long)f->size : (long long)e->pos;
+    e->pos = offset + done;
+  }
+
+  if(done <= 0)
+    return;
+
+  if(f->tracked && (uint64_t)(offset + done) > f->extent)
+    f->extent = offset + done;
+
+  if(is_write)
+  {
+    if((uint64_t)(offset + done) > f->size)
+      f->size = offset + done;
+    emit(OPTRACE_WRITE, f, offset, done, 0, start, end, pid);
+  }
+  else
+  {
+    if((uint64_t)(offset + done) > f->size)
+      f->size = offset + done;
+    emit(OPTRACE_READ, f, offset, done, 0, start, end, pid);
+  }
+}
+
+static void do_unlink(int pid, char *dir, char *name, uint64_t start,
+  uint64_t end)
+{
+  char path[MAX_LINE];
+  file *f;
+
+  resolve_path(path, dir, name);
+  if(!in_root(path))
+    return;
+
+  f = lookup_file(path);
+  first_use(f);
+  if(!f->exists)
+    return;
+
+  emit(OPTRACE_DELETE, f, 0, f->size, 0, start, end, pid);
+  f->exists = 0;
+  f->tracked = 0;
+}
+
+static void do_rename(int pid, char *old_dir, char *old_name, char *new_dir,
+  char *new_name, uint64_t start, uint64_t end)
+{
+  char old_path[MAX_LINE], new_path[MAX_LINE];
+  file *src = NULL, *dst = NULL;
+  fd_entry *e;
+  int i;
+
+  resolve_path(old_path, old_dir, old_name);
+  resolve_path(new_path, new_dir, new_name);
+
+  if(in_root(old_path))
+  {
+    src = lookup_file(old_path);
+    first_use(src);
+  }
+  if(in_root(new_path))
+  {
+    dst = lookup_file(new_path);
+    dst->seen = 1;
+  }
+
+  if(src && src == dst)
+    return;
+  else if(src && dst)
+    emit(OPTRACE_RENAME, src, 0, src->size, dst->id, start, end, pid);
+  else if(src)                      /* moved out of the root */
+    emit(OPTRACE_DELETE, src, 0, src->size, 0, start, end, pid);
+  else if(dst)                      /* moved in, contents unknown */
+    emit(OPTRACE_CREATE, dst, 0, 0, 0, start, end, pid);
+
+  if(dst)
+  {
+    dst->exists = 1;
+    dst->tracked = 0;
+    dst->size = src ? src->size : 0;
+  }
+
+  if(src)
+  {
+    src->exists = 0;
+    src->tracked = 0;
+  }
+
+  /* open descriptors follow the file */
+  for(i = 0; i < HASH_SIZE; i++)
+    for(e = fds[i]; e; e = e->next)
+      if(src && e->f == src)
+        e->f = dst;
+}
+
+static void do_dup(int pid, int oldfd, int newfd)
+{
+  fd_entry *e = lookup_fd(pid, oldfd), *d;
+
+  if(e == NULL || oldfd == newfd)
+    return;
+
+  if((d = lookup_fd(pid, newfd)))
+    remove_fd(d);
+
+  d = add_fd(pid, newfd, e->path, e->f);
+  d->pos = e->pos;
+  d->append = e->append;
+  d->dup = 1;
+}
+
+/**
+ * A new thread shares the descriptor table of 'pid', a new process gets a
+ * copy of it
+ */
+static void do_fork(int pid, int child, int shared)
+{
+  int table = fd_table(pid), i;
+  fd_entry *e, *next, *d;
+
+  if(shared)
+  {
+    set_fd_table(child, table);
+    return;
+  }
+
+  /* a table left by an earlier process of that pid is dropped */
+  for(i = 0; i < HASH_SIZE; i++)
+    for(e = fds[i]; e; e = next)
+    {
+      next = e->next;
+      if(e->table == child)
+        remove_fd(e);
+    }
+
+  set_fd_table(child, child);
+  for(i = 0; i < HASH_SIZE; i++)
+    for(e = fds[i]; e; e = e->next)
+      if(e->table == table)
+      {
+        d = add_fd(child, e->fd, e->path, e->f);
+        d->pos = e->pos;
+        d->append = e->append;
+        d->dup = 1;
+      }
+}
+
+static void do_call(int pid, uint64_t start, char *call)
+{
+  char *name, *args[MAX_ARGS];
+  char path[MAX_LINE], path2[MAX_LINE];
+  long long ret;
+  double duration;
+  uint64_t end;
+  fd_entry *e;
+  int argc, i;
+
+  if((argc = split_call(call, &name, args, &ret, &duration)) < 0 || ret < 0)
+    return;
+  end = start + (uint64_t)(duration * 1e9);
+
+  if(!strcmp(name, "open") && argc >= 2 && !parse_string(path, args[0]))
+    do_open(pid, NULL, path, args[1], ret, start, end);
+  else if(!strcmp(name, "openat") && argc >= 3
+    && !parse_string(path, args[1]))
+    do_open(pid, dirfd_path(pid, args[0]), path, args[2], ret, start, end);
+  else if(!strcmp(name, "openat2") && argc >= 3
+    && !parse_string(path, args[1]))
+    do_open(pid, dirfd_path(pid, args[0]), path, args[2], ret, start, end);
+  else if(!strcmp(name, "creat") && argc >= 1
+    && !parse_string(path, args[0]))
+    do_open(pid, NULL, path, "O_CREAT|O_TRUNC", ret, start, end);
+  else if((!strcmp(name, "read") || !strcmp(name, "readv")) && argc >= 1)
+    do_io(pid, arg_number(args[0]), 0, -1, ret, start, end);
+  else if((!strncmp(name, "pread", 5) || !strncmp(name, "preadv", 6))
+    && argc >= 4)
+    do_io(pid, arg_number(args[0]), 0, arg_number(args[3]), ret, start, end);
+  else if((!strcmp(name, "write") || !strcmp(name, "writev")) && argc >= 1)
+    do_io(pid, arg_number(args[0]), 1, -1, ret, start, end);
+  else if((!strncmp(name, "pwrite", 6) || !strncmp(name, "pwritev", 7))
+    && argc >= 4)
+    do_io(pid, arg_number(args[0]), 1, arg_number(args[3]), ret, start, end);
+  else if(!strcmp(name, "lseek") && argc >= 1)
+  {
+    if((e = lookup_fd(pid, arg_number(args[0]))))
+      e->pos = ret;
+  }
+  else if((!strcmp(name, "fsync") || !strcmp(name, "fdatasync"))
+    && argc >= 1)
+  {
+    if((e = lookup_fd(pid, arg_number(args[0]))) && e->f)
+      emit(OPTRACE_FSYNC, e->f, 0, 0,
+        (name[1] == 'd') ? OPTRACE_FSYNC_DATA : 0, start, end, pid);
+  }
+  else if(!strcmp(name, "syncfs") && argc >= 1)
+  {
+    if((e = lookup_fd(pid, arg_number(args[0]))) && e->f)
+      emit(OPTRACE_FSYNC, e->f, 0, 0, OPTRACE_FSYNC_FS, start, end, pid);
+  }
+  else if(!strcmp(name, "close") && argc >= 1)
+  {
+    if((e = lookup_fd(pid, arg_number(args[0]))))
+    {
+      if(e->f && !e->dup)
+        emit(OPTRACE_CLOSE, e->f, 0, 0, 0, start, end, pid);
+      remove_fd(e);
+    }
+  }
+  else if(!strcmp(name, "unlink") && argc >= 1
+    && !parse_string(path, args[0]))
+    do_unlink(pid, NULL, path, start, end);
+  else if(!strcmp(name, "unlinkat") && argc >= 3
+    && !parse_string(path, args[1]) && !strstr(args[2], "AT_REMOVEDIR"))
+    do_unlink(pid, dirfd_path(pid, args[0]), path, start, end);
+  else if(!strcmp(name, "rename") && argc >= 2
+    && !parse_string(path, args[0]) && !parse_string(path2, args[1]))
+    do_rename(pid, NULL, path, NULL, path2, start, end);
+  else if(!strncmp(name, "renameat", 8) && argc >= 4
+    && !parse_string(path, args[1]) && !parse_string(path2, args[3]))
+    do_rename(pid, dirfd_path(pid, args[0]), path, dirfd_path(pid, args[2]),
+      path2, start, end);
+  else if(!strcmp(name, "dup") && argc >= 1)
+    do_dup(pid, arg_number(args[0]), ret);
+  else if((!strcmp(name, "dup2") || !strcmp(name, "dup3")) && argc >= 2)
+    do_dup(pid, arg_number(args[0]), ret);
+  else if(!strcmp(name, "fcntl") && argc >= 2 && strstr(args[1], "F_DUPFD"))
+    do_dup(pid, arg_number(args[0]), ret);
+  else if(!strcmp(name, "fork") || !strcmp(name, "vfork"))
+    do_fork(pid, ret, 0);
+  else if(!strncmp(name, "clone", 5) && ret > 0)
+  {
+    for(i = 0; i < argc && !strstr(args[i], "CLONE_FILES"); i++)
+      ;
+    do_fork(pid, ret, i < argc);
+  }
+  else if(!strcmp(name, "chdir") && argc >= 1
+    && !parse_string(path, args[0]))
+  {
+    resolve_path(path2, NULL, path);
+    strcpy(cwd, path2);
+  }
+}
+
+/**
+ * Timestamp of -tt (HH:MM:SS.us) or -ttt (seconds.us) in ns, wrapping over
+ * midnight for -tt
+ */
+static int parse_time(char *token, uint64_t *ns)
+{
+  unsigned int h, m;
+  double s;
+
+  if(strchr(token, ':'))
+  {
+    if(sscanf(token, "%u:%u:%lf", &h, &m, &s) != 3)
+      return -1;
+    *ns = (uint64_t)((h * 3600 + m * 60) * 1e9 + s * 1e9 + 0.5) + day_offset;
+    if(*ns + DAY_NS / 2 < last_ts)
+    {
+      day_offset += DAY_NS;
+      *ns += DAY_NS;
+    }
+  }
+  else
+  {
+    if(sscanf(token, "%lf", &s) != 1)
+      return -1;
+    *ns = (uint64_t)(s * 1e9 + 0.5);
+    epoch_ts = 1;
+  }
+
+  last_ts = *ns;
+  return 0;
+}
+
+static void do_line(char *line)
+{
+  char *p = line, *time_token, *call, *full;
+  pending_call *pc;
+  uint64_t ts;
+  int pid = 0, n, i;
+
+  /* "[pid N] " or "N " prefix of strace -f */
+  if(sscanf(p, "[pid %d] %n", &pid, &n) == 1)
+    p += n;
+  else if(sscanf(p, "%d %n", &pid, &n) == 1 && p[strspn(p, "0123456789")]
+    == ' ')
+    p += n;
+  else
+    pid = 0;
+
+  time_token = p;
+  if((p = strchr(p, ' ')) == NULL)
+    return;
+  *p++ = '\0';
+  if(parse_time(time_token, &ts) != 0)
+    return;
+  if(first_ts == 0)
+    first_ts = ts;
+
+  call = p;
+  if(!strncmp(call, "+++", 3) || !strncmp(call, "---", 3))
+    return;
+
+  /* split calls: "name(args <unfinished ...>" then
+     "<... name resumed>rest" */
+  if((p = strstr(call, " <unfinished ...>")) != NULL)
+  {
+    *p = '\0';
+    for(i = 0; i < MAX_PENDING && pending[i].text; i++)
+      ;
+    if(i == MAX_PENDING)
+    {
+      skipped++;
+      return;
+    }
+    pending[i].pid = pid;
+    pending[i].start = ts;
+    pending[i].text = strdup(call);
+    return;
+  }
+
+  if(!strncmp(call, "<... ", 5))
+  {
+    for(i = 0; i < MAX_PENDING; i++)
+      if(pending[i].text && pending[i].pid == pid)
+        break;
+    if(i == MAX_PENDING || (p = strstr(call, "resumed>")) == NULL)
+    {
+      skipped++;
+      return;
+    }
+
+    pc = &pending[i];
+    p += 8;
+    full = (char *)malloc(strlen(pc->text) + strlen(p) + 1);
+    if(full == NULL)
+    {
+      fprintf(stderr, "Error: out of memory\n");
+      exit(EXIT_FAILURE);
+    }
+    strcpy(full, pc->text);
+    strcat(full, p);
+    do_call(pid, pc->start, full);
+
+    free(full);
+    free(pc->text);
+    pc->text = NULL;
+    return;
+  }
+
+  do_call(pid, ts, call);
+}
+
+int main(int argc, char **argv)
+{
+  static char line[MAX_LINE];
+  char *map_path = NULL;
+  FILE *in;
+  size_t len;
+  int opt;
+
+  while((opt = getopt(argc, argv, "r:m:h")) != -1)
+  {
+    switch(opt)
+    {
+      case 'r':
+        root = optarg;
+        normalize_path(root);
+        break;
+      case 'm':
+        map_path = optarg;
+        break;
+      default:
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+  }
+
+  if(argc - optind != 2)
+  {
+    usage(argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  if(!strcmp(argv[optind], "-"))
+    in = stdin;
+  else if((in = fopen(argv[optind], "r")) == NULL)
+  {
+    fprintf(stderr, "Error: cannot open strace log '%s'\n", argv[optind]);
+    return EXIT_FAILURE;
+  }
+
+  if((body = tmpfile()) == NULL)
+  {
+    perror("tmpfile");
+    return EXIT_FAILURE;
+  }
+
+  while(fgets(line, sizeof(line), in))
+  {
+    len = strlen(line);
+    if(len && line[len - 1] == '\n')
+      line[--len] = '\0';
+    do_line(line);
+  }
+
+  if(in != stdin)
+    fclose(in);
+
+  if(write_trace(argv[optind + 1], map_path) != 0)
+    return EXIT_FAILURE;
+
+  fprintf(stderr, "%lu operations on %u files converted", records,
+    next_id - 1);
+  if(skipped)
+    fprintf(stderr, ", %lu unmatched split calls skipped", skipped);
+  fprintf(stderr, "\n");
+
+  return EXIT_SUCCESS;
+}
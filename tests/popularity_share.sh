@@ -0,0 +1,67 @@
+#!/bin/sh
+# With 'set popularity hotset 0.1 0.9', the 10% hot files must receive about
+# 90% of the reads and appends, and about 10% of them when uniform. The
+# accesses of each file are counted in a recorded trace, the hot files being
+# its 12% most accessed ones since the hot set size varies a little.
+
+FFSMARK=${FFSMARK:-./ffsmark}
+DIR=$(mktemp -d /tmp/ffsmark-test.XXXXXX) || exit 1
+trap 'rm -rf "$DIR"' EXIT
+
+# percentage of the reads and appends of the trace going to its 'top' most
+# accessed files - records are 40 bytes after a 32-byte header, file_id at
+# byte 24 and op at byte 38 (1 read, 2 append)
+share() {
+  od -An -v -j32 -w40 -tu1 "$1" | awk -v top="$2" '
+    $39 == 1 || $39 == 2 {
+      count[$25 + 256 * ($26 + 256 * ($27 + 256 * $28))]++; total++
+    }
+    END {
+      for(f in count) print count[f]
+      print "total", total
+    }' | sort -k1,1nr | awk -v top="$2" '
+    $1 == "total" { total = $2; next }
+    NR <= top { hot += $1 }
+    END { printf "%d\n", total ? 100 * hot / total : 0 }'
+}
+
+status=0
+for popularity in "hotset 0.1 0.9:80:97" "uniform:5:25"; do
+  name=${popularity%%:*}
+  range=${popularity#*:}
+  low=${range%:*}
+  high=${range#*:}
+
+  rm -rf "$DIR/fs"
+  mkdir "$DIR/fs"
+  cat > "$DIR/run.cfg" <<END
+set number 500
+set size 512 4096
+set transactions 10000
+set bias create -1
+set location $DIR/fs
+set popularity $name
+set record $DIR/run.trc
+run
+quit
+END
+
+  if ! $FFSMARK "$DIR/run.cfg" > /dev/null 2> "$DIR/run.err" \
+    || [ -s "$DIR/run.err" ]; then
+    echo "FAIL: run with 'set popularity $name'"
+    cat "$DIR/run.err"
+    status=1
+    continue
+  fi
+
+  percent=$(share "$DIR/run.trc" 60)
+  if [ "$percent" -lt "$low" ] || [ "$percent" -gt "$high" ]; then
+    echo "FAIL: 'set popularity $name', 12% most accessed files got" \
+      "$percent% of the accesses, not $low-$high%"
+    status=1
+    continue
+  fi
+  echo "ok: 'set popularity $name', 12% most accessed files got $percent%"
+done
+
+exit $status
@@ -0,0 +1,55 @@
+#!/bin/sh
+# A run recorded under each sync policy must replay without any error:
+# every fsync record follows the creation of its file and no file is
+# synced once deleted.
+
+FFSMARK=${FFSMARK:-./ffsmark}
+DIR=$(mktemp -d /tmp/ffsmark-test.XXXXXX) || exit 1
+trap 'rm -rf "$DIR"' EXIT
+
+config() {
+  cat <<END
+set number 200
+set subdirectories 5
+set size 512 10240
+set transactions 2000
+set read 4096
+set write 4096
+set buffering false
+set location $DIR/fs
+set threads 1
+END
+}
+
+status=0
+for policy in "write" "close fdatasync" "every 4" "group 4" \
+  "group 4 fdatasync"; do
+  rm -rf "$DIR/fs" "$DIR/run.trc"
+  mkdir "$DIR/fs"
+  { config; echo "set fsync $policy"; echo "set record $DIR/run.trc";
+    echo "run"; echo "quit"; } > "$DIR/record.cfg"
+  { config; echo "set replay $DIR/run.trc"; echo "run"; echo "quit"; } \
+    > "$DIR/replay.cfg"
+
+  if ! $FFSMARK "$DIR/record.cfg" > /dev/null 2> "$DIR/record.err" \
+    || [ -s "$DIR/record.err" ]; then
+    echo "FAIL: recording with 'set fsync $policy'"
+    cat "$DIR/record.err"
+    status=1
+    continue
+  fi
+
+  rm -rf "$DIR/fs"
+  mkdir "$DIR/fs"
+  if ! $FFSMARK "$DIR/replay.cfg" > /dev/null 2> "$DIR/replay.err" \
+    || [ -s "$DIR/replay.err" ]; then
+    echo "FAIL: replay of 'set fsync $policy', $(grep -c Error \
+      "$DIR/replay.err") errors"
+    head -5 "$DIR/replay.err"
+    status=1
+    continue
+  fi
+  echo "ok: replay of 'set fsync $policy'"
+done
+
+exit $status
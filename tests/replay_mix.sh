@@ -0,0 +1,64 @@
+#!/bin/sh
+# A run whose mix renames, moves and truncates files must replay without
+# any error: those operations are recorded, so that the replayed files
+# follow the recorded ones.
+
+FFSMARK=${FFSMARK:-./ffsmark}
+DIR=$(mktemp -d /tmp/ffsmark-test.XXXXXX) || exit 1
+trap 'rm -rf "$DIR"' EXIT
+
+config() {
+  cat <<END
+set number 200
+set subdirectories 5
+set size 512 10240
+set transactions 2000
+set read 4096
+set write 4096
+set buffering false
+set location $DIR/fs
+END
+}
+
+status=0
+for pregenerate in false true; do
+  rm -rf "$DIR/fs" "$DIR/run.trc"
+  mkdir "$DIR/fs"
+  { config; echo "set mix read 2 append 2 rename 1 move 1 truncate 1"
+    echo "set pregenerate $pregenerate"; echo "set record $DIR/run.trc"
+    echo "run"; echo "quit"; } > "$DIR/record.cfg"
+  { config; echo "set replay $DIR/run.trc"; echo "run"; echo "quit"; } \
+    > "$DIR/replay.cfg"
+
+  if ! $FFSMARK "$DIR/record.cfg" > /dev/null 2> "$DIR/record.err" \
+    || [ -s "$DIR/record.err" ]; then
+    echo "FAIL: recording of the mix (pregenerate $pregenerate)"
+    cat "$DIR/record.err"
+    status=1
+    continue
+  fi
+
+  rm -rf "$DIR/fs"
+  mkdir "$DIR/fs"
+  if ! $FFSMARK "$DIR/replay.cfg" > "$DIR/replay.out" \
+    2> "$DIR/replay.err" || [ -s "$DIR/replay.err" ]; then
+    echo "FAIL: replay of the mix (pregenerate $pregenerate), $(grep -c \
+      Error "$DIR/replay.err") errors"
+    head -5 "$DIR/replay.err"
+    status=1
+    continue
+  fi
+  missing=
+  for op in rename truncate; do
+    grep -q "^[[:space:]]*$op " "$DIR/replay.out" || missing="$missing $op"
+  done
+  if [ -n "$missing" ]; then
+    echo "FAIL: nothing replayed for$missing (pregenerate $pregenerate)"
+    status=1
+    continue
+  fi
+  echo "ok: replay of a mix with renames and truncates (pregenerate" \
+    "$pregenerate)"
+done
+
+exit $status
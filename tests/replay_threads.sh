@@ -0,0 +1,43 @@
+#!/bin/sh
+# A run recorded by several worker threads must replay without any error:
+# the records of the threads are merged in start time order.
+
+FFSMARK=${FFSMARK:-./ffsmark}
+DIR=$(mktemp -d /tmp/ffsmark-test.XXXXXX) || exit 1
+trap 'rm -rf "$DIR"' EXIT
+
+config() {
+  cat <<END
+set number 400
+set subdirectories 5
+set size 512 10240
+set transactions 4000
+set read 4096
+set write 4096
+set buffering false
+set location $DIR/fs
+END
+}
+
+mkdir "$DIR/fs"
+{ config; echo "set threads 4"; echo "set record $DIR/run.trc";
+  echo "run"; echo "quit"; } > "$DIR/record.cfg"
+{ config; echo "set replay $DIR/run.trc"; echo "run"; echo "quit"; } \
+  > "$DIR/replay.cfg"
+
+if ! $FFSMARK "$DIR/record.cfg" > /dev/null 2> "$DIR/record.err" \
+  || [ -s "$DIR/record.err" ]; then
+  echo "FAIL: recording with 4 threads"
+  cat "$DIR/record.err"
+  exit 1
+fi
+
+rm -rf "$DIR/fs"
+mkdir "$DIR/fs"
+if ! $FFSMARK "$DIR/replay.cfg" > /dev/null 2> "$DIR/replay.err" \
+  || [ -s "$DIR/replay.err" ]; then
+  echo "FAIL: replay of 4 threads, $(grep -c Error "$DIR/replay.err") errors"
+  head -5 "$DIR/replay.err"
+  exit 1
+fi
+echo "ok: replay of 4 threads"
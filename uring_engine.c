@@ -0,0 +1,429 @@
+/*
+ * FFSMark
+ * Pierre Olivier <pierre.olivier@univ-brest.fr>
+ *
+ * Copyright (c) of University of Occidental Britanny (UBO) <pierre.olivier@univ-brest.fr>, 2015.
+ *
+ *	This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ * NO WARRANTY. THIS SOFTWARE IS FURNISHED ON AN "AS IS" BASIS.
+ * UNIVERSITY OF OCCIDENTAL BRITANNY MAKES NO WARRANTIES OF ANY KIND, EITHER
+ * EXPRESSED OR IMPLIED AS TO THE MATTER INCLUDING, BUT NOT LIMITED
+ * TO: WARRANTY OF FITNESS FOR PURPOSE OR MERCHANTABILITY, EXCLUSIVITY
+ * OF RESULTS OR RESULTS OBTAINED FROM USE OF THIS SOFTWARE. 
+ * See the GNU General Public License for more details.
+ *
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define _GNU_SOURCE
+
+#include "uring_engine.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+
+/* Chain item holding the open and the close of the fixed file */
+#define ITEM_OPEN   (-1)
+#define ITEM_CLOSE  (-2)
+
+typedef struct
+{
+  int fd;
+  unsigned depth;
+  int fixed;                  /* open/close go through the ring */
+  unsigned *sq_head, *sq_tail, *sq_mask, *sq_array;
+  unsigned *cq_head, *cq_tail, *cq_mask;
+  struct io_uring_sqe *sqes;
+  struct io_uring_cqe *cqes;
+  void *sq_ptr, *cq_ptr;
+  size_t sq_len, cq_len, sqes_len;
+  long *items;                /* item of each SQE of a chain ... */
+  int *res;                   /* ... and its result, depth entries */
+} uring;
+
+/* description of one whole file access */
+typedef struct
+{
+  char *path;
+  int flags;
+  mode_t mode;
+  int opcode;                 /* IORING_OP_READ or IORING_OP_WRITE */
+  off_t offset;
+  char *buf;
+  int size;
+  int block;
+  int advance;                /* 1 if the buffer advances with the offset */
+} uring_access;
+
+static __thread uring *ring = NULL;
+
+static int uring_probe_fixed(uring *r);
+static int uring_submit_wait(uring *r, unsigned n);
+static void uring_prep(struct io_uring_sqe *sqe, uring_access *a, long item,
+  int fd, int fixed);
+static int uring_access_run(uring_access *a);
+
+int uring_engine_setup(unsigned depth)
+{
+  struct io_uring_params p;
+  uring *r;
+  int fds[1] = {-1};
+
+  if(ring)
+    return 0;
+
+  if(depth == 0 || depth > URING_ENGINE_MAX_DEPTH)
+  {
+    fprintf(stderr, "Error: invalid io_uring queue depth %u\n", depth);
+    return -1;
+  }
+
+  r = (uring *)calloc(1, sizeof(uring));
+  if(r == NULL)
+  {
+    perror("calloc");
+    return -1;
+  }
+
+  memset(&p, 0, sizeof(p));
+  r->fd = syscall(__NR_io_uring_setup, depth, &p);
+  if(r->fd == -1)
+  {
+    perror("io_uring_setup");
+    free(r);
+    return -1;
+  }
+  r->depth = p.sq_entries;
+
+  r->items = (long *)malloc(r->depth * sizeof(long));
+  r->res = (int *)malloc(r->depth * sizeof(int));
+  if(r->items == NULL || r->res == NULL)
+  {
+    perror("malloc");
+    goto out_free;
+  }
+
+  r->sq_len = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+  r->cq_len = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+  if(p.features & IORING_FEAT_SINGLE_MMAP)
+  {
+    if(r->cq_len > r->sq_len)
+      r->sq_len = r->cq_len;
+    r->cq_len = 0;
+  }
+
+  r->sq_ptr = mmap(NULL, r->sq_len, PROT_READ | PROT_WRITE,
+    MAP_SHARED | MAP_POPULATE, r->fd, IORING_OFF_SQ_RING);
+  if(r->sq_ptr == MAP_FAILED)
+    goto out_mmap;
+
+  if(r->cq_len)
+  {
+    r->cq_ptr = mmap(NULL, r->cq_len, PROT_READ | PROT_WRITE,
+      MAP_SHARED | MAP_POPULATE, r->fd, IORING_OFF_CQ_RING);
+    if(r->cq_ptr == MAP_FAILED)
+      goto out_unmap_sq;
+  }
+  else
+    r->cq_ptr = r->sq_ptr;
+
+  r->sqes_len = p.sq_entries * sizeof(struct io_uring_sqe);
+  r->sqes = mmap(NULL, r->sqes_len, PROT_READ | PROT_WRITE,
+    MAP_SHARED | MAP_POPULATE, r->fd, IORING_OFF_SQES);
+  if(r->sqes == MAP_FAILED)
+    goto out_unmap_cq;
+
+  r->sq_head = (unsigned *)((char *)r->sq_ptr + p.sq_off.head);
+  r->sq_tail = (unsigned *)((char *)r->sq_ptr + p.sq_off.tail);
+  r->sq_mask = (unsigned *)((char *)r->sq_ptr + p.sq_off.ring_mask);
+  r->sq_array = (unsigned *)((char *)r->sq_ptr + p.sq_off.array);
+  r->cq_head = (unsigned *)((char *)r->cq_ptr + p.cq_off.head);
+  r->cq_tail = (unsigned *)((char *)r->cq_ptr + p.cq_off.tail);
+  r->cq_mask = (unsigned *)((char *)r->cq_ptr + p.cq_off.ring_mask);
+  r->cqes = (struct io_uring_cqe *)((char *)r->cq_ptr + p.cq_off.cqes);
+
+  /* a single sparse fixed file slot receives the file being accessed */
+  if(syscall(__NR_io_uring_register, r->fd, IORING_REGISTER_FILES, fds, 1)
+    == 0)
+    r->fixed = uring_probe_fixed(r);
+
+  ring = r;
+  return 0;
+
+out_unmap_cq:
+  if(r->cq_ptr != r->sq_ptr)
+    munmap(r->cq_ptr, r->cq_len);
+out_unmap_sq:
+  munmap(r->sq_ptr, r->sq_len);
+out_mmap:
+  perror("mmap");
+out_free:
+  close(r->fd);
+  free(r->items);
+  free(r->res);
+  free(r);
+  return -1;
+}
+
+void uring_engine_teardown()
+{
+  if(!ring)
+    return;
+
+  munmap(ring->sqes, ring->sqes_len);
+  if(ring->cq_ptr != ring->sq_ptr)
+    munmap(ring->cq_ptr, ring->cq_len);
+  munmap(ring->sq_ptr, ring->sq_len);
+  close(ring->fd);
+  free(ring->items);
+  free(ring->res);
+  free(ring);
+  ring = NULL;
+}
+
+int uring_engine_write(char *path, int flags, mode_t mode, off_t offset,
+  char *src, int size, int block)
+{
+  uring_access a = {path, flags, mode, IORING_OP_WRITE, offset, src, size,
+    block, 1};
+
+  return uring_access_run(&a);
+}
+
+int uring_engine_read(char *path, int flags, off_t offset, char *buf,
+  int size, int block)
+{
+  uring_access a = {path, flags, 0, IORING_OP_READ, offset, buf, size,
+    block, 0};
+
+  return uring_access_run(&a);
+}
+
+/**
+ * Check that opening into and closing a fixed file slot works (5.15+),
+ * otherwise open() and close() stay synchronous. The open/close chain
+ * needs a depth of 2 at least.
+ */
+static int uring_probe_fixed(uring *r)
+{
+  uring_access a = {".", O_RDONLY | O_DIRECTORY, 0, IORING_OP_READ, 0,
+    NULL, 0, 1, 0};
+
+  if(r->depth < 2)
+    return 0;
+
+  r->items[0] = ITEM_OPEN;
+  uring_prep(&r->sqes[0], &a, ITEM_OPEN, 0, 1);
+  r->sqes[0].flags |= IOSQE_IO_LINK;
+  r->items[1] = ITEM_CLOSE;
+  uring_prep(&r->sqes[1], &a, ITEM_CLOSE, 0, 1);
+  if(uring_submit_wait(r, 2) != 0)
+    return 0;
+
+  return (r->res[0] >= 0 && r->res[1] >= 0);
+}
+
+static void uring_prep(struct io_uring_sqe *sqe, uring_access *a, long item,
+  int fd, int fixed)
+{
+  memset(sqe, 0, sizeof(*sqe));
+
+  if(item == ITEM_OPEN)
+  {
+    sqe->opcode = IORING_OP_OPENAT;
+    sqe->fd = AT_FDCWD;
+    sqe->addr = (unsigned long)a->path;
+    sqe->len = a->mode;
+    sqe->open_flags = a->flags;
+    sqe->file_index = 1;
+  }
+  else if(item == ITEM_CLOSE)
+  {
+    sqe->opcode = IORING_OP_CLOSE;
+    sqe->file_index = 1;
+  }
+  else
+  {
+    off_t pos = (off_t)item * a->block;
+    int len = a->size - pos;
+
+    if(len > a->block)
+      len = a->block;
+
+    sqe->opcode = a->opcode;
+    sqe->fd = fd;
+    sqe->addr = (unsigned long)(a->buf + (a->advance ? pos : 0));
+    sqe->len = len;
+    sqe->off = a->offset + pos;
+    if(fixed)
+      sqe->flags |= IOSQE_FIXED_FILE;
+  }
+}
+
+/**
+ * Queue the n SQEs prepared in sqes[0..n), wait for their completions and
+ * store the result of sqes[i] in r->res[i]: completions of a chain may come
+ * back in any order, they are matched by their user_data, the SQE index.
+ * Return -1 if not all of them could be submitted, once the submitted ones
+ * completed.
+ */
+static int uring_submit_wait(uring *r, unsigned n)
+{
+  unsigned tail, head, i, submitted = 0, completed = 0;
+  struct io_uring_cqe *cqe;
+  int ret, status = 0;
+
+  tail = *r->sq_tail;
+  for(i = 0; i < n; i++)
+  {
+    r->sqes[i].user_data = i;
+    r->sq_array[(tail + i) & *r->sq_mask] = i;
+  }
+  __atomic_store_n(r->sq_tail, tail + n, __ATOMIC_RELEASE);
+
+  /* the kernel may take fewer SQEs than asked, the rest is resubmitted */
+  while(submitted < n)
+  {
+    ret = syscall(__NR_io_uring_enter, r->fd, n - submitted, 0, 0, NULL, 0);
+    if(ret > 0)
+      submitted += ret;
+    else if(ret == -1 && errno == EINTR)
+      continue;
+    else if(ret == -1 && (errno == EAGAIN || errno == EBUSY)
+      && submitted > completed)
+    {
+      /* out of resources: let completions in flight free some */
+      ret = syscall(__NR_io_uring_enter, r->fd, 0, 1, IORING_ENTER_GETEVENTS,
+        NULL, 0);
+      if(ret == -1 && errno != EINTR)
+        break;
+    }
+    else
+      break;
+  }
+
+  if(submitted < n)
+  {
+    perror("io_uring_enter");
+    /* take back the SQEs the kernel did not consume */
+    __atomic_store_n(r->sq_tail, tail + submitted, __ATOMIC_RELEASE);
+    status = -1;
+  }
+
+  while(completed < submitted)
+  {
+    head = *r->cq_head;
+    if(head == __atomic_load_n(r->cq_tail, __ATOMIC_ACQUIRE))
+    {
+      ret = syscall(__NR_io_uring_enter, r->fd, 0, 1,
+        IORING_ENTER_GETEVENTS, NULL, 0);
+      if(ret == -1 && errno != EINTR)
+      {
+        perror("io_uring_enter");
+        return -1;
+      }
+      continue;
+    }
+
+    cqe = &r->cqes[head & *r->cq_mask];
+    if(cqe->user_data < n)
+      r->res[cqe->user_data] = cqe->res;
+    __atomic_store_n(r->cq_head, head + 1, __ATOMIC_RELEASE);
+    completed++;
+  }
+
+  return status;
+}
+
+/**
+ * Submit the sequence [open] block_0 ... block_n-1 [close] as chains of at
+ * most depth linked SQEs, one chain in flight at a time
+ */
+static int uring_access_run(uring_access *a)
+{
+  long blocks, total, pos, item;
+  int fd = 0, opened = 0, closed = 0, failed = 0, done = 0;
+  unsigned n, i;
+
+  if(!ring)
+    return -1;
+
+  blocks = a->size / a->block + ((a->size % a->block) ? 1 : 0);
+  total = blocks + (ring->fixed ? 2 : 0);
+
+  if(!ring->fixed)
+  {
+    fd = open(a->path, a->flags, a->mode);
+    if(fd == -1)
+      return -1;
+    opened = 1;
+  }
+
+  for(pos = 0; pos < total && !failed; )
+  {
+    for(n = 0; n < ring->depth && pos < total; n++, pos++)
+    {
+      if(!ring->fixed)
+        item = pos;
+      else if(pos == 0)
+        item = ITEM_OPEN;
+      else if(pos == total - 1)
+        item = ITEM_CLOSE;
+      else
+        item = pos - 1;
+
+      ring->items[n] = item;
+      uring_prep(&ring->sqes[n], a, item, fd, ring->fixed);
+      if(n)
+        ring->sqes[n - 1].flags |= IOSQE_IO_LINK;
+    }
+
+    for(i = 0; i < n; i++)
+      ring->res[i] = -ECANCELED;
+
+    if(uring_submit_wait(ring, n) != 0)
+      failed = 1;
+
+    for(i = 0; i < n; i++)
+    {
+      if(ring->items[i] == ITEM_OPEN)
+        opened = (ring->res[i] >= 0);
+      else if(ring->items[i] == ITEM_CLOSE)
+        closed = (ring->res[i] >= 0);
+      else if(ring->res[i] >= 0)
+        done += ring->res[i];
+
+      if(ring->res[i] < 0)
+        failed = 1;
+    }
+  }
+
+  /* the fixed slot is released whatever failed, closing an empty slot
+     being harmless */
+  if(!ring->fixed)
+  {
+    if(opened)
+      close(fd);
+  }
+  else if(!closed)
+  {
+    ring->items[0] = ITEM_CLOSE;
+    uring_prep(&ring->sqes[0], a, ITEM_CLOSE, 0, 1);
+    uring_submit_wait(ring, 1);
+  }
+
+  return opened ? done : -1;
+}
@@ -0,0 +1,48 @@
+/*
+ * FFSMark
+ * Pierre Olivier <pierre.olivier@univ-brest.fr>
+ *
+ * Copyright (c) of University of Occidental Britanny (UBO) <pierre.olivier@univ-brest.fr>, 2015.
+ *
+ *	This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ * NO WARRANTY. THIS SOFTWARE IS FURNISHED ON AN "AS IS" BASIS.
+ * UNIVERSITY OF OCCIDENTAL BRITANNY MAKES NO WARRANTIES OF ANY KIND, EITHER
+ * EXPRESSED OR IMPLIED AS TO THE MATTER INCLUDING, BUT NOT LIMITED
+ * TO: WARRANTY OF FITNESS FOR PURPOSE OR MERCHANTABILITY, EXCLUSIVITY
+ * OF RESULTS OR RESULTS OBTAINED FROM USE OF THIS SOFTWARE. 
+ * See the GNU General Public License for more details.
+ *
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef URING_ENGINE_H
+#define URING_ENGINE_H
+
+#include <sys/types.h>
+
+#define URING_ENGINE_MAX_DEPTH  4096
+
+/**
+ * io_uring based I/O engine. Each thread owns its ring, set up with
+ * uring_engine_setup() and released with uring_engine_teardown().
+ *
+ * A file access (open, block reads/writes from 'offset', close) is
+ * submitted as linked chains of at most 'depth' SQEs, the file being opened into a
+ * fixed file slot when the kernel supports it. Return the number of bytes
+ * transferred, or -1 if the file could not be opened.
+ */
+int uring_engine_setup(unsigned depth);
+void uring_engine_teardown();
+int uring_engine_write(char *path, int flags, mode_t mode, off_t offset,
+  char *src, int size, int block);
+int uring_engine_read(char *path, int flags, off_t offset, char *buf,
+  int size, int block);
+
+#endif /* URING_ENGINE_H */